@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "../include/command.h"
+#include "../include/shell.h"
+#include "../include/script.h"
+#include "../include/builtin.h"
+#include "../include/supervise.h"
+#include "../include/complete.h"
+
+/*
+ * Microbenchmarks for psh, linked against the shell's own objects:
+ *   spawn    - "true" through spawn_proc()
+ *   pipeline - MB/s through fork_cmd_node() with 1..8 stages
+ *   parse    - lines/s through split_line() and script_parse()
+ *   dispatch - searchBuiltInCommand() lookups and an in-process built-in via run_cmd()
+ *   complete - building the $PATH command index and Tab lookups against it
+ * Every metric is a rate (higher is better) and is written as one flat JSON
+ * object, so a saved run can be read back as a baseline and compared.
+ */
+
+int history_count;
+char *history[MAX_RECORD_NUM];
+
+#define MAX_METRICS 64
+
+struct metric {
+	char name[64];
+	double value;
+};
+
+static struct metric metrics[MAX_METRICS];
+static int metric_count;
+static double scale = 1.0;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long scaled(long n)
+{
+	long v = (long)(n * scale);
+	return v > 0 ? v : 1;
+}
+
+static void record_metric(const char *name, double value)
+{
+	if (metric_count == MAX_METRICS)
+		return;
+	snprintf(metrics[metric_count].name, sizeof(metrics[0].name), "%s", name);
+	metrics[metric_count].value = value;
+	++metric_count;
+	fprintf(stderr, "%-40s %14.1f\n", name, value);
+}
+
+static struct cmd_node *make_node(const char *const *argv, const char *out_file)
+{
+	int n = 0;
+	while (argv[n])
+		++n;
+	struct cmd_node *node = new_cmd_node(n);
+	for (int i = 0; i < n; ++i)
+		node->args[i] = strdup(argv[i]);
+	node->length = n;
+	if (out_file)
+		node->out_file = strdup(out_file);
+	return node;
+}
+
+static void free_nodes(struct cmd_node *node)
+{
+	while (node) {
+		struct cmd_node *next = node->next;
+		for (int i = 0; i < node->length; ++i)
+			free(node->args[i]);
+		free(node->args);
+		free(node->out_file);
+		free(node);
+		node = next;
+	}
+}
+
+// ============================ spawn ============================
+static void bench_spawn(void)
+{
+	static const char *const argv[] = { "true", NULL };
+	long n = scaled(2000);
+	double begin = now();
+	for (long i = 0; i < n; ++i) {
+		struct cmd_node *p = make_node(argv, NULL);
+		spawn_proc(p);
+		free_nodes(p);
+	}
+	record_metric("spawn.true_per_sec", n / (now() - begin));
+}
+
+// ============================ pipeline ============================
+static void bench_pipeline(int stages)
+{
+	static const char *const cat_argv[] = { "cat", NULL };
+	long bytes = scaled(64) << 20;
+	char size[32], name[64];
+	snprintf(size, sizeof(size), "%ld", bytes);
+	const char *head_argv[] = { "head", "-c", size, "/dev/zero", NULL };
+
+	struct cmd cmd = { 0 };
+	struct cmd_node **tail = &cmd.head;
+	for (int i = 0; i < stages; ++i) {
+		const char *out = i == stages - 1 ? "/dev/null" : NULL;
+		*tail = make_node(i == 0 ? head_argv : cat_argv, out);
+		tail = &(*tail)->next;
+		++cmd.pipe_num;
+	}
+	double begin = now();
+	fork_cmd_node(&cmd);
+	double elapsed = now() - begin;
+	free_nodes(cmd.head);
+	snprintf(name, sizeof(name), "pipeline.%d_stage_mb_per_sec", stages);
+	record_metric(name, bytes / (1 << 20) / elapsed);
+}
+
+// ============================ parse ============================
+static const struct {
+	const char *shape;
+	const char *line;
+} shapes[] = {
+	{ "simple", "ls -l /tmp" },
+	{ "args", "gcc -Wall -O2 -c src/shell.c -o shell.o -I include -g" },
+	{ "pipeline", "cat demo.txt | grep psh | sort | uniq -c | sort -n | head -5" },
+	{ "redirect", "sort -r < input.txt > output.txt" },
+	{ "timed", "time find . -name x | wc -l" },
+};
+
+static void free_split(struct cmd *cmd)
+{
+	// split_line() points args/files into the line, so only the nodes are owned
+	while (cmd->head) {
+		struct cmd_node *next = cmd->head->next;
+		free(cmd->head->args);
+		free(cmd->head);
+		cmd->head = next;
+	}
+	free(cmd);
+}
+
+static void bench_parse(void)
+{
+	char buf[BUF_SIZE], name[64];
+	long n = scaled(200000);
+	for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+		size_t len = strlen(shapes[s].line) + 1;
+		double begin = now();
+		for (long i = 0; i < n; ++i) {
+			// split_line() tokenises in place
+			memcpy(buf, shapes[s].line, len);
+			free_split(split_line(buf));
+		}
+		snprintf(name, sizeof(name), "parse.split_line.%s_per_sec", shapes[s].shape);
+		record_metric(name, n / (now() - begin));
+
+		begin = now();
+		for (long i = 0; i < n; ++i) {
+			enum script_status status;
+			const char *error;
+			script_free(script_parse(shapes[s].line, &status, &error));
+		}
+		snprintf(name, sizeof(name), "parse.script_parse.%s_per_sec", shapes[s].shape);
+		record_metric(name, n / (now() - begin));
+	}
+}
+
+// ============================ dispatch ============================
+static void bench_dispatch(void)
+{
+	char name[64];
+	long n = scaled(2000000);
+	char *args[2] = { NULL, NULL };
+	struct cmd_node node = { .args = args, .length = 1 };
+	const struct builtin *volatile sink;
+
+	// first and last entries bound the lookup cost, a miss is what every external command pays
+	const char *names[] = { builtin_at(0)->name, builtin_at(num_builtins() - 1)->name, "ls" };
+	for (int k = 0; k < 3; ++k) {
+		args[0] = (char *)names[k];
+		double begin = now();
+		for (long i = 0; i < n; ++i)
+			sink = searchBuiltInCommand(&node);
+		snprintf(name, sizeof(name), "dispatch.lookup_%s_per_sec", k == 2 ? "miss" : names[k]);
+		record_metric(name, n / (now() - begin));
+	}
+	(void)sink;
+
+	// the whole in-process path: lookup, stdin/stdout save and restore, the call itself
+	static const char *const cd_argv[] = { "cd", ".", NULL };
+	long m = scaled(200000);
+	double begin = now();
+	for (long i = 0; i < m; ++i) {
+		struct cmd cmd = { .head = make_node(cd_argv, NULL), .pipe_num = 1 };
+		run_cmd(&cmd);
+		free_nodes(cmd.head);
+	}
+	record_metric("dispatch.run_cmd_cd_per_sec", m / (now() - begin));
+}
+
+// ============================ complete ============================
+static void bench_complete(void)
+{
+	double begin = now();
+	complete_init();
+	record_metric("complete.index_builds_per_sec", 1 / (now() - begin));
+
+	// a short prefix with many matches and the common-extension walk of a longer one
+	static const char *const prefixes[] = { "g", "pyth" };
+	char name[64];
+	long n = scaled(200000);
+	for (int k = 0; k < 2; ++k) {
+		size_t len = strlen(prefixes[k]);
+		begin = now();
+		for (long i = 0; i < n; ++i) {
+			char *ext;
+			complete_lookup(prefixes[k], len, &ext);
+			free(ext);
+		}
+		snprintf(name, sizeof(name), "complete.lookup_%s_per_sec", prefixes[k]);
+		record_metric(name, n / (now() - begin));
+	}
+}
+
+// ============================ report ============================
+static void write_json(const char *path)
+{
+	FILE *fp = path ? fopen(path, "w") : stdout;
+	if (fp == NULL) {
+		perror(path);
+		exit(1);
+	}
+	fprintf(fp, "{\n");
+	for (int i = 0; i < metric_count; ++i)
+		fprintf(fp, "  \"%s\": %.1f%s\n", metrics[i].name, metrics[i].value,
+				i + 1 < metric_count ? "," : "");
+	fprintf(fp, "}\n");
+	if (path)
+		fclose(fp);
+}
+
+/**
+ * @brief Compare this run against a JSON file written by an earlier run
+ *
+ * @param path Baseline file, one "name": value pair per line
+ */
+static void compare(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "bench: no baseline at %s\n", path);
+		return;
+	}
+	char line[256], name[64];
+	double base;
+	fprintf(stderr, "\n%-40s %14s %14s %8s\n", "metric", "baseline", "now", "change");
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, " \"%63[^\"]\": %lf", name, &base) != 2)
+			continue;
+		for (int i = 0; i < metric_count; ++i) {
+			if (strcmp(metrics[i].name, name) != 0)
+				continue;
+			fprintf(stderr, "%-40s %14.1f %14.1f %+7.1f%%\n", name, base, metrics[i].value,
+					base > 0 ? (metrics[i].value / base - 1) * 100 : 0.0);
+		}
+	}
+	fclose(fp);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out = NULL, *baseline = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "o:b:s:")) != -1) {
+		switch (opt) {
+		case 'o': out = optarg; break;
+		case 'b': baseline = optarg; break;
+		case 's': scale = atof(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-o out.json] [-b baseline.json] [-s scale]\n", argv[0]);
+			return 2;
+		}
+	}
+	for (int i = 0; i < MAX_RECORD_NUM; ++i)
+		history[i] = (char *)calloc(BUF_SIZE, sizeof(char));
+	supervise_init();
+
+	bench_spawn();
+	for (int stages = 1; stages <= 8; stages *= 2)
+		bench_pipeline(stages);
+	bench_parse();
+	bench_dispatch();
+	bench_complete();
+
+	write_json(out);
+	if (baseline)
+		compare(baseline);
+	return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <sched.h>
+#include <stdbool.h>
+
+/*
+ * Placement of a command's processes, from prefix words such as
+ * "@cpus=2-5 nice=-5 sched=fifo:10 cgroup=/sys/fs/cgroup/bench cmd | cmd2".
+ * Applied in every stage's child between fork() and execvp().
+ */
+struct sched_spec {
+	bool set_cpus;
+	cpu_set_t cpus;
+	bool set_nice;
+	int nice;
+	int policy;		// -1 keeps the inherited policy
+	int priority;	// SCHED_FIFO / SCHED_RR priority
+	char *cgroup;	// cgroup v2 directory, NULL for none
+};
+
+int affinity_parse(const char *word, bool in_block, struct sched_spec **spec);
+int affinity_apply(const struct sched_spec *spec);
+void affinity_free(struct sched_spec *spec);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <stdbool.h>
+#include "vars.h"
+
+enum arith_op {
+	A_NUM, A_VAR,
+	A_NEG, A_POS, A_NOT, A_BNOT,
+	A_PREINC, A_PREDEC, A_POSTINC, A_POSTDEC,
+	A_MUL, A_DIV, A_MOD, A_ADD, A_SUB, A_SHL, A_SHR,
+	A_LT, A_LE, A_GT, A_GE, A_EQ, A_NE,
+	A_BAND, A_BXOR, A_BOR, A_AND, A_OR,
+	A_COND, A_ASSIGN, A_COMMA,
+};
+
+/*
+ * Arithmetic expression tree of $(( )), (( )) and for (( ; ; )).
+ * For A_ASSIGN, "assign_op" is the binary operator of a compound
+ * assignment (A_ADD for +=) or A_ASSIGN for plain "=".
+ */
+struct arith {
+	enum arith_op op, assign_op;
+	long long num;
+	struct var *var;
+	struct arith *a, *b, *c;
+};
+
+struct arith *arith_parse(const char *expr, const char **error);
+long long arith_eval(struct arith *node, bool *ok);
+void arith_free(struct arith *node);
+
+#endif
@@ -1,21 +1,43 @@
 #ifndef BUILTIN_H
 #define BUILTIN_H
+#include <stdint.h>
 #include "../include/command.h"
 
+#define BUILTIN_PIPELINE	0x1
+#define BUILTIN_FORK		0x2
 
-int searchBuiltInCommand(struct cmd_node *cmd);
-int execBuiltInCommand(int status,struct cmd_node *cmd);
+struct builtin {
+	const char *name;
+	int (*func)(char **args, int *status);	// 0 to exit the shell; *status is the exit status
+	unsigned flags;
+};
 
-int pwd(char **args);
-int help(char **args);
-int cd(char **args);
-int echo(char **args);
-int exit_shell(char **args);
-int record(char **args);
+/*
+ * Hash of a command name into the built-in table, shared with the generator
+ * that picks the seed making it collision-free for the names in builtins.def.
+ */
+static inline uint32_t builtin_hash(const char *name, uint32_t seed)
+{
+	uint32_t h = 2166136261u ^ seed;
+	for (const unsigned char *c = (const unsigned char *)name; *c; ++c)
+		h = (h ^ *c) * 16777619u;
+	return h ^ (h >> 15);
+}
 
-extern const char *builtin_str[];
+const struct builtin *searchBuiltInCommand(struct cmd_node *cmd);
+int execBuiltInCommand(const struct builtin *builtin, struct cmd_node *cmd, int *status);
+const struct builtin *builtin_at(int i);
 
-extern const int (*builtin_func[]) (char **);
+int pwd(char **args, int *status);
+int help(char **args, int *status);
+int cd(char **args, int *status);
+int echo(char **args, int *status);
+int exit_shell(char **args, int *status);
+int record(char **args, int *status);
+int cat(char **args, int *status);
+int cp(char **args, int *status);
+int set(char **args, int *status);
+int timeout_cmd(char **args, int *status);
 
 extern int num_builtins();
 
@@ -5,6 +5,9 @@
 #define BUF_SIZE 1024
 
 #include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/resource.h>
 
 struct cmd_node {
 	char **args;
@@ -12,19 +15,30 @@ struct cmd_node {
 	char *in_file, *out_file;
 	int in,out;
 	struct cmd_node *next;
-	
+
+	// filled in by spawn_proc() once the stage has been reaped
+	pid_t pid;		// -1 until forked (or if fork failed), 0 for a built-in run in the shell
+	int status;
+	struct rusage ru;
+	struct timespec start, end;
 };
 
+struct sched_spec;
+
 struct cmd {
 	struct cmd_node *head;
 	int pipe_num;
+	bool timed;
+	double timeout;		// seconds before the pipeline is killed, 0 for none
+	struct sched_spec *sched;	// "@cpus=..." placement of every stage, NULL for none
 };
 
 extern char *history[MAX_RECORD_NUM];
 extern int history_count;
 
-char *read_line();
+char *read_line(const char *prompt, bool *eof);
 struct cmd *split_line(char *);
+struct cmd_node *new_cmd_node(int args_length);
 void test_cmd_struct(struct cmd *);
 void test_pipe_struct(struct cmd_node *pipe);
 #endif
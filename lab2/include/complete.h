@@ -0,0 +1,14 @@
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#include <stddef.h>
+
+// PATH directories beyond this many are neither indexed nor watched
+#define COMPLETE_MAX_DIRS 64
+
+void complete_init(void);
+void complete_refresh(void);
+int complete_lookup(const char *prefix, size_t len, char **extension);
+int complete_matches(const char *prefix, size_t len, char **out, int limit);
+
+#endif
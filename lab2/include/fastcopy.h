@@ -0,0 +1,8 @@
+#ifndef FASTCOPY_H
+#define FASTCOPY_H
+
+#include <sys/types.h>
+
+ssize_t copy_fd(int in, int out);
+
+#endif
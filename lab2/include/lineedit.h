@@ -0,0 +1,11 @@
+#ifndef LINEEDIT_H
+#define LINEEDIT_H
+
+#include <stdbool.h>
+
+extern bool line_edit_enabled;
+
+void line_edit_init(void);
+char *line_edit(const char *prompt, bool *eof);
+
+#endif
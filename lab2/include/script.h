@@ -0,0 +1,18 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include "command.h"
+
+enum script_status {
+	SCRIPT_OK,
+	SCRIPT_INCOMPLETE,	// more input needed, e.g. a "while" without its "done"
+	SCRIPT_ERROR,
+};
+
+struct script_node;
+
+struct script_node *script_parse(const char *text, enum script_status *status, const char **error);
+int script_exec(struct script_node *node);
+void script_free(struct script_node *node);
+
+#endif
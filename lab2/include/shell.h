@@ -3,9 +3,12 @@
 
 #include "command.h"
 
+extern int last_status;
+
 int spawn_proc(struct cmd_node *);
 int fork_cmd_node(struct cmd *cmd);
-void redirection(struct cmd_node *cmd);
+int redirection(struct cmd_node *cmd);
+int run_cmd(struct cmd *cmd);
 void shell();
 
 #endif
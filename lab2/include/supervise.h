@@ -0,0 +1,19 @@
+#ifndef SUPERVISE_H
+#define SUPERVISE_H
+
+#include <stdbool.h>
+#include "command.h"
+
+#define TIMEOUT_STATUS 124
+#define TIMEOUT_KILL_GRACE 2.0
+
+void supervise_init(void);
+void supervise_prepare(void);
+void supervise_child(pid_t pgid);
+void supervise_child_signals(void);
+void supervise_adopt(pid_t pid, pid_t pgid);
+int supervise_wait(struct cmd_node *head, double timeout);
+bool supervise_interrupted(void);
+double parse_duration(const char *s);
+
+#endif
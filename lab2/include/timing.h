@@ -0,0 +1,14 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "command.h"
+
+struct time_mark {
+	struct timespec wall;
+	struct rusage self;
+};
+
+void time_mark(struct time_mark *mark);
+void time_report(struct cmd *cmd, const struct time_mark *begin, const struct time_mark *end);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define TRACE_MAX_EVENTS (1 << 16)
+#define TRACE_ENV "PSH_TRACE"
+
+extern bool trace_enabled;
+
+void trace_init(void);
+int trace_start(const char *path);
+void trace_stop(void);
+void trace_flush(void);
+void trace_checkpoint(void);
+
+uint64_t trace_now(void);
+void trace_span(const char *name, const char *detail, uint64_t start);
+void trace_span_on(pid_t tid, const char *name, const char *detail, uint64_t start, uint64_t end);
+void trace_instant(const char *name, const char *detail);
+
+#endif
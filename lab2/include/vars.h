@@ -0,0 +1,28 @@
+#ifndef VARS_H
+#define VARS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define VAR_TABLE_SIZE 256
+
+/*
+ * A shell variable. Slots are never freed, so the parser can resolve a
+ * name once and keep the pointer in the AST instead of hashing on every use.
+ */
+struct var {
+	char *name;
+	char *value;		// NULL while unset (the environment is consulted then)
+	long long ival;		// cached integer value, valid when has_ival
+	bool has_ival;
+	struct var *next;
+};
+
+struct var *var_lookup(const char *name, size_t len);
+const char *var_get(struct var *v);
+long long var_get_int(struct var *v);
+void var_set(struct var *v, const char *value);
+void var_set_int(struct var *v, long long n);
+bool var_name_valid(const char *name, size_t len);
+
+#endif
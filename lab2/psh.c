@@ -2,6 +2,9 @@
 #include <stdio.h>
 #include "include/shell.h"
 #include "include/command.h"
+#include "include/trace.h"
+#include "include/supervise.h"
+#include "include/lineedit.h"
 
 int history_count;
 char *history[MAX_RECORD_NUM];
@@ -13,7 +16,11 @@ int main(int argc, char *argv[])
 	for (int i = 0; i < MAX_RECORD_NUM; ++i)
     	history[i] = (char *)malloc(BUF_SIZE * sizeof(char));
 
+	supervise_init();
+	line_edit_init();
+	trace_init();
 	shell();
+	trace_stop();
 
 	for (int i = 0; i < MAX_RECORD_NUM; ++i)
     	free(history[i]);
@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "../include/affinity.h"
+
+// "2-5,7,9-10"
+static bool parse_cpus(const char *s, cpu_set_t *set)
+{
+	CPU_ZERO(set);
+	while (*s) {
+		char *end;
+		long lo = strtol(s, &end, 10), hi = lo;
+		if (end == s || lo < 0)
+			return false;
+		if (*end == '-') {
+			s = end + 1;
+			hi = strtol(s, &end, 10);
+			if (end == s || hi < lo)
+				return false;
+		}
+		if (hi >= CPU_SETSIZE)
+			return false;
+		for (long c = lo; c <= hi; ++c)
+			CPU_SET(c, set);
+		if (*end == ',')
+			++end;
+		else if (*end != '\0')
+			return false;
+		s = end;
+	}
+	return CPU_COUNT(set) > 0;
+}
+
+static bool parse_int(const char *s, int *out)
+{
+	char *end;
+	long v = strtol(s, &end, 10);
+	if (end == s || *end != '\0')
+		return false;
+	*out = (int)v;
+	return true;
+}
+
+// "fifo:10", "rr", "batch", "idle", "other"
+static bool parse_policy(const char *s, struct sched_spec *spec)
+{
+	static const struct {
+		const char *name;
+		int policy;
+	} policies[] = {
+		{ "other", SCHED_OTHER }, { "batch", SCHED_BATCH }, { "idle", SCHED_IDLE },
+		{ "fifo", SCHED_FIFO }, { "rr", SCHED_RR },
+	};
+	const char *colon = strchr(s, ':');
+	size_t len = colon ? (size_t)(colon - s) : strlen(s);
+	for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); ++i) {
+		if (strlen(policies[i].name) != len || strncmp(s, policies[i].name, len) != 0)
+			continue;
+		spec->policy = policies[i].policy;
+		if (colon)
+			return parse_int(colon + 1, &spec->priority);
+		if ((spec->policy == SCHED_FIFO || spec->policy == SCHED_RR) && spec->priority == 0)
+			spec->priority = 1;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief 
+ * Recognise one placement prefix word and add it to *spec (allocated on first use).
+ * A block of placement words starts with '@' ("@cpus=0-3"); after that the
+ * '@' may be dropped ("@cpus=0-3 nice=5").
+ * @param word Word to examine
+ * @param in_block Whether an '@' word has already been seen
+ * @param spec Placement being built
+ * @return int 
+ * Return 1 if the word was a placement, 0 if it is not one, -1 if it is malformed
+ */
+int affinity_parse(const char *word, bool in_block, struct sched_spec **spec)
+{
+	bool marked = word[0] == '@';
+	if (marked)
+		++word;
+	else if (!in_block)
+		return 0;
+
+	const char *eq = strchr(word, '=');
+	if (eq == NULL)
+		return marked ? -1 : 0;
+	size_t klen = eq - word;
+	const char *value = eq + 1;
+	bool known = (klen == 4 && strncmp(word, "cpus", 4) == 0) ||
+			(klen == 4 && strncmp(word, "nice", 4) == 0) ||
+			(klen == 5 && strncmp(word, "sched", 5) == 0) ||
+			(klen == 4 && strncmp(word, "prio", 4) == 0) ||
+			(klen == 6 && strncmp(word, "cgroup", 6) == 0);
+	if (!known)
+		return marked ? -1 : 0;
+
+	if (*spec == NULL) {
+		*spec = (struct sched_spec *)calloc(1, sizeof(struct sched_spec));
+		(*spec)->policy = -1;
+	}
+	struct sched_spec *s = *spec;
+	bool ok = true;
+	switch (word[0]) {
+	case 'c':
+		if (word[1] == 'p') {
+			ok = parse_cpus(value, &s->cpus);
+			s->set_cpus = ok;
+		} else {
+			free(s->cgroup);
+			s->cgroup = strdup(value);
+			ok = value[0] != '\0';
+		}
+		break;
+	case 'n':
+		ok = parse_int(value, &s->nice);
+		s->set_nice = ok;
+		break;
+	case 's':
+		ok = parse_policy(value, s);
+		break;
+	case 'p':
+		ok = parse_int(value, &s->priority);
+		break;
+	}
+	return ok ? 1 : -1;
+}
+
+static int join_cgroup(const char *dir)
+{
+	char path[4096], pid[24];
+	snprintf(path, sizeof(path), "%s/cgroup.procs", dir);
+	int fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	int n = snprintf(pid, sizeof(pid), "%d\n", getpid());
+	int ret = write(fd, pid, n) == n ? 0 : -1;
+	close(fd);
+	return ret;
+}
+
+/**
+ * @brief Apply a placement to the calling process, called in the child before execvp()
+ * 
+ * @param spec Placement, may be NULL
+ * @return int 
+ * Return 0 on success, -1 with an error printed otherwise
+ */
+int affinity_apply(const struct sched_spec *spec)
+{
+	if (spec == NULL)
+		return 0;
+	if (spec->cgroup && join_cgroup(spec->cgroup) == -1) {
+		perror(spec->cgroup);
+		return -1;
+	}
+	if (spec->set_cpus && sched_setaffinity(0, sizeof(spec->cpus), &spec->cpus) == -1) {
+		perror("psh: cpus");
+		return -1;
+	}
+	if (spec->policy != -1) {
+		struct sched_param param = { .sched_priority = 0 };
+		if (spec->policy == SCHED_FIFO || spec->policy == SCHED_RR)
+			param.sched_priority = spec->priority;
+		if (sched_setscheduler(0, spec->policy, &param) == -1) {
+			perror("psh: sched");
+			return -1;
+		}
+	}
+	if (spec->set_nice && setpriority(PRIO_PROCESS, 0, spec->nice) == -1) {
+		perror("psh: nice");
+		return -1;
+	}
+	return 0;
+}
+
+void affinity_free(struct sched_spec *spec)
+{
+	if (spec == NULL)
+		return;
+	free(spec->cgroup);
+	free(spec);
+}
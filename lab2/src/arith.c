@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../include/arith.h"
+
+struct arith_parser {
+	const char *p;
+	const char *error;
+};
+
+static struct arith *parse_comma(struct arith_parser *ps);
+static struct arith *parse_assign(struct arith_parser *ps);
+
+static struct arith *new_node(enum arith_op op, struct arith *a, struct arith *b)
+{
+	struct arith *node = (struct arith *)calloc(1, sizeof(struct arith));
+	node->op = op;
+	node->a = a;
+	node->b = b;
+	return node;
+}
+
+static void skip_space(struct arith_parser *ps)
+{
+	while (isspace((unsigned char)*ps->p))
+		++ps->p;
+}
+
+// consume "tok" if it comes next (and is not the prefix of a longer operator in "unless")
+static bool accept(struct arith_parser *ps, const char *tok, const char *unless)
+{
+	skip_space(ps);
+	size_t n = strlen(tok);
+	if (strncmp(ps->p, tok, n) != 0)
+		return false;
+	if (unless && ps->p[n] != '\0' && strchr(unless, ps->p[n]))
+		return false;
+	ps->p += n;
+	return true;
+}
+
+static struct arith *fail(struct arith_parser *ps, const char *msg, struct arith *a, struct arith *b)
+{
+	if (ps->error == NULL)
+		ps->error = msg;
+	arith_free(a);
+	arith_free(b);
+	return NULL;
+}
+
+static struct arith *parse_primary(struct arith_parser *ps)
+{
+	skip_space(ps);
+	if (accept(ps, "(", NULL)) {
+		struct arith *node = parse_comma(ps);
+		if (node == NULL)
+			return NULL;
+		if (!accept(ps, ")", NULL))
+			return fail(ps, "expected ')'", node, NULL);
+		return node;
+	}
+	if (isdigit((unsigned char)*ps->p)) {
+		char *end;
+		struct arith *node = new_node(A_NUM, NULL, NULL);
+		node->num = strtoll(ps->p, &end, 0);
+		ps->p = end;
+		if (isalnum((unsigned char)*ps->p) || *ps->p == '_')
+			return fail(ps, "invalid number", node, NULL);
+		return node;
+	}
+	if (*ps->p == '$')
+		++ps->p;
+	const char *start = ps->p;
+	while (isalnum((unsigned char)*ps->p) || *ps->p == '_')
+		++ps->p;
+	if (!var_name_valid(start, ps->p - start))
+		return fail(ps, "operand expected", NULL, NULL);
+	struct arith *node = new_node(A_VAR, NULL, NULL);
+	node->var = var_lookup(start, ps->p - start);
+	return node;
+}
+
+static struct arith *parse_postfix(struct arith_parser *ps)
+{
+	struct arith *node = parse_primary(ps);
+	if (node == NULL)
+		return NULL;
+	if (accept(ps, "++", NULL) || accept(ps, "--", NULL)) {
+		if (node->op != A_VAR)
+			return fail(ps, "++/-- needs a variable", node, NULL);
+		return new_node(ps->p[-1] == '+' ? A_POSTINC : A_POSTDEC, node, NULL);
+	}
+	return node;
+}
+
+static struct arith *parse_unary(struct arith_parser *ps)
+{
+	enum arith_op op;
+	if (accept(ps, "++", NULL))
+		op = A_PREINC;
+	else if (accept(ps, "--", NULL))
+		op = A_PREDEC;
+	else if (accept(ps, "-", "="))
+		op = A_NEG;
+	else if (accept(ps, "+", "="))
+		op = A_POS;
+	else if (accept(ps, "!", "="))
+		op = A_NOT;
+	else if (accept(ps, "~", NULL))
+		op = A_BNOT;
+	else
+		return parse_postfix(ps);
+
+	struct arith *operand = parse_unary(ps);
+	if (operand == NULL)
+		return NULL;
+	if ((op == A_PREINC || op == A_PREDEC) && operand->op != A_VAR)
+		return fail(ps, "++/-- needs a variable", operand, NULL);
+	return new_node(op, operand, NULL);
+}
+
+/*
+ * Binary operators from tightest to loosest binding. "unless" lists the
+ * characters that, following the operator, make it a different operator
+ * ("<" followed by "<" or "=" is not less-than).
+ */
+static const struct {
+	const char *tok, *unless;
+	enum arith_op op;
+	int level;
+} binops[] = {
+	{"*", "=", A_MUL, 0}, {"/", "=", A_DIV, 0}, {"%", "=", A_MOD, 0},
+	{"+", "=+", A_ADD, 1}, {"-", "=-", A_SUB, 1},
+	{"<<", "=", A_SHL, 2}, {">>", "=", A_SHR, 2},
+	{"<=", NULL, A_LE, 3}, {">=", NULL, A_GE, 3}, {"<", "<=", A_LT, 3}, {">", ">=", A_GT, 3},
+	{"==", NULL, A_EQ, 4}, {"!=", NULL, A_NE, 4},
+	{"&", "&=", A_BAND, 5},
+	{"^", "=", A_BXOR, 6},
+	{"|", "|=", A_BOR, 7},
+	{"&&", NULL, A_AND, 8},
+	{"||", NULL, A_OR, 9},
+};
+#define BINARY_LEVELS 10
+
+static struct arith *parse_binary(struct arith_parser *ps, int level)
+{
+	if (level < 0)
+		return parse_unary(ps);
+	struct arith *left = parse_binary(ps, level - 1);
+	while (left != NULL) {
+		enum arith_op op = A_NUM;
+		for (size_t i = 0; i < sizeof(binops) / sizeof(binops[0]); ++i) {
+			if (binops[i].level == level && accept(ps, binops[i].tok, binops[i].unless)) {
+				op = binops[i].op;
+				break;
+			}
+		}
+		if (op == A_NUM)
+			break;
+		struct arith *right = parse_binary(ps, level - 1);
+		if (right == NULL)
+			return fail(ps, "operand expected", left, NULL);
+		left = new_node(op, left, right);
+	}
+	return left;
+}
+
+static struct arith *parse_cond(struct arith_parser *ps)
+{
+	struct arith *cond = parse_binary(ps, BINARY_LEVELS - 1);
+	if (cond == NULL || !accept(ps, "?", NULL))
+		return cond;
+	struct arith *yes = parse_assign(ps);
+	if (yes == NULL)
+		return fail(ps, "operand expected", cond, NULL);
+	if (!accept(ps, ":", NULL))
+		return fail(ps, "expected ':'", cond, yes);
+	struct arith *no = parse_cond(ps);
+	if (no == NULL)
+		return fail(ps, "operand expected", cond, yes);
+	struct arith *node = new_node(A_COND, cond, yes);
+	node->c = no;
+	return node;
+}
+
+static struct arith *parse_assign(struct arith_parser *ps)
+{
+	static const struct {
+		const char *tok;
+		enum arith_op op;
+	} assigns[] = {
+		{"*=", A_MUL}, {"/=", A_DIV}, {"%=", A_MOD}, {"+=", A_ADD}, {"-=", A_SUB},
+		{"<<=", A_SHL}, {">>=", A_SHR}, {"&=", A_BAND}, {"^=", A_BXOR}, {"|=", A_BOR},
+	};
+	struct arith *left = parse_cond(ps);
+	if (left == NULL || left->op != A_VAR)
+		return left;
+
+	enum arith_op op = A_NUM;
+	if (accept(ps, "=", "="))
+		op = A_ASSIGN;
+	for (size_t i = 0; op == A_NUM && i < sizeof(assigns) / sizeof(assigns[0]); ++i)
+		if (accept(ps, assigns[i].tok, NULL))
+			op = assigns[i].op;
+	if (op == A_NUM)
+		return left;
+
+	struct arith *right = parse_assign(ps);
+	if (right == NULL)
+		return fail(ps, "operand expected", left, NULL);
+	struct arith *node = new_node(A_ASSIGN, left, right);
+	node->assign_op = op;
+	return node;
+}
+
+static struct arith *parse_comma(struct arith_parser *ps)
+{
+	struct arith *left = parse_assign(ps);
+	while (left != NULL && accept(ps, ",", NULL)) {
+		struct arith *right = parse_assign(ps);
+		if (right == NULL)
+			return fail(ps, "operand expected", left, NULL);
+		left = new_node(A_COMMA, left, right);
+	}
+	return left;
+}
+
+/**
+ * @brief Parse an arithmetic expression once so it can be evaluated many times
+ * 
+ * @param expr Expression text, e.g. "i < 10" or "i += 2"
+ * @param error Set to a message when the expression is malformed
+ * @return struct arith* 
+ * Return the expression tree, or NULL on error
+ */
+struct arith *arith_parse(const char *expr, const char **error)
+{
+	struct arith_parser ps = { expr, NULL };
+	struct arith *node = parse_comma(&ps);
+	skip_space(&ps);
+	if (node != NULL && *ps.p != '\0')
+		node = fail(&ps, "syntax error in expression", node, NULL);
+	*error = ps.error;
+	return node;
+}
+
+// +, -, * and << wrap around in unsigned arithmetic instead of overflowing
+#define WRAP(x, op, y) ((long long)((unsigned long long)(x) op (unsigned long long)(y)))
+
+static long long apply(enum arith_op op, long long x, long long y, bool *ok)
+{
+	switch (op) {
+	case A_MUL:  return WRAP(x, *, y);
+	case A_DIV:
+	case A_MOD:
+		if (y == 0) {
+			fprintf(stderr, "psh: division by 0\n");
+			*ok = false;
+			return 0;
+		}
+		// LLONG_MIN / -1 traps; -x wraps to the same value the division would
+		if (y == -1)
+			return op == A_DIV ? WRAP(0, -, x) : 0;
+		return op == A_DIV ? x / y : x % y;
+	case A_ADD:  return WRAP(x, +, y);
+	case A_SUB:  return WRAP(x, -, y);
+	case A_SHL:
+	case A_SHR:
+		if (y < 0 || y > 63) {
+			fprintf(stderr, "psh: shift count %lld out of range\n", y);
+			*ok = false;
+			return 0;
+		}
+		return op == A_SHL ? WRAP(x, <<, y) : x >> y;
+	case A_LT:   return x < y;
+	case A_LE:   return x <= y;
+	case A_GT:   return x > y;
+	case A_GE:   return x >= y;
+	case A_EQ:   return x == y;
+	case A_NE:   return x != y;
+	case A_BAND: return x & y;
+	case A_BXOR: return x ^ y;
+	case A_BOR:  return x | y;
+	default:     return y;
+	}
+}
+
+/**
+ * @brief Evaluate an expression tree, assigning variables along the way
+ * 
+ * @param node Tree from arith_parse()
+ * @param ok Cleared on a run-time error such as division by zero
+ * @return long long 
+ * Return the value of the expression
+ */
+long long arith_eval(struct arith *node, bool *ok)
+{
+	long long x, y;
+	switch (node->op) {
+	case A_NUM:
+		return node->num;
+	case A_VAR:
+		return var_get_int(node->var);
+	case A_NEG:
+		return WRAP(0, -, arith_eval(node->a, ok));
+	case A_POS:
+		return arith_eval(node->a, ok);
+	case A_NOT:
+		return !arith_eval(node->a, ok);
+	case A_BNOT:
+		return ~arith_eval(node->a, ok);
+	case A_PREINC:
+	case A_PREDEC:
+		x = WRAP(var_get_int(node->a->var), +, node->op == A_PREINC ? 1 : -1);
+		var_set_int(node->a->var, x);
+		return x;
+	case A_POSTINC:
+	case A_POSTDEC:
+		x = var_get_int(node->a->var);
+		var_set_int(node->a->var, WRAP(x, +, node->op == A_POSTINC ? 1 : -1));
+		return x;
+	case A_AND:
+		return arith_eval(node->a, ok) && arith_eval(node->b, ok);
+	case A_OR:
+		return arith_eval(node->a, ok) || arith_eval(node->b, ok);
+	case A_COND:
+		return arith_eval(node->a, ok) ? arith_eval(node->b, ok) : arith_eval(node->c, ok);
+	case A_COMMA:
+		arith_eval(node->a, ok);
+		return arith_eval(node->b, ok);
+	case A_ASSIGN:
+		y = arith_eval(node->b, ok);
+		if (node->assign_op != A_ASSIGN)
+			y = apply(node->assign_op, var_get_int(node->a->var), y, ok);
+		if (*ok)
+			var_set_int(node->a->var, y);
+		return y;
+	default:
+		x = arith_eval(node->a, ok);
+		y = arith_eval(node->b, ok);
+		return apply(node->op, x, y, ok);
+	}
+}
+
+void arith_free(struct arith *node)
+{
+	if (node == NULL)
+		return;
+	arith_free(node->a);
+	arith_free(node->b);
+	arith_free(node->c);
+	free(node);
+}
@@ -6,7 +6,16 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
 #include "../include/builtin.h"
+#include "../include/fastcopy.h"
+#include "../include/trace.h"
+#include "../include/supervise.h"
+#include "../builtin_table.h"
 
 
 
@@ -14,68 +23,87 @@
  * @brief 
  * Determine whether cmd is a built-in command
  * @param cmd Command structure
- * @return int 
- * If command is built-in command return function number
- * If command is external command return -1 
+ * @return const struct builtin* 
+ * If command is built-in command return its table entry
+ * If command is external command return NULL 
  */
-int searchBuiltInCommand(struct cmd_node *cmd)
+const struct builtin *searchBuiltInCommand(struct cmd_node *cmd)
 {
-	for (int i = 0; i < num_builtins(); ++i){
-		if (strcmp(cmd->args[0], builtin_str[i]) == 0){
-			return i;
-		}
-	}
-	return -1;
+	const struct builtin *b = &builtin_table[builtin_hash(cmd->args[0], BUILTIN_SEED) & (BUILTIN_SLOTS - 1)];
+	if (b->name && strcmp(cmd->args[0], b->name) == 0)
+		return b;
+	return NULL;
 }
 /**
  * @brief Execute built-in command
  * 
- * @param status Choose which built-in command to execute
+ * @param builtin Built-in command to execute
  * @param cmd Command structure
+ * @param status Set to the command's exit status, 0 on success
  * @return int 
- * Return execution status
+ * Return 1 to keep the shell running, 0 when it should exit
  */
-int execBuiltInCommand(int status,struct cmd_node *cmd){
-	status = (*builtin_func[status])(cmd->args);
-	return status;
+int execBuiltInCommand(const struct builtin *builtin, struct cmd_node *cmd, int *status){
+	*status = 0;
+	return builtin->func(cmd->args, status);
 }
 
-int help(char **args)
+/**
+ * @brief The i-th built-in in the order of builtins.def
+ * 
+ * @param i Index below num_builtins()
+ * @return const struct builtin* 
+ */
+const struct builtin *builtin_at(int i)
+{
+	return &builtin_table[builtin_order[i]];
+}
+
+int num_builtins() {
+	return sizeof(builtin_order) / sizeof(builtin_order[0]);
+}
+
+int help(char **args, int *status)
 {
 	int i;
     printf("--------------------------------------------------\n");
   	printf("My Little Shell!!\n");
 	printf("The following are built in:\n");
 	for (i = 0; i < num_builtins(); i++) {
-    	printf("%d: %s\n", i, builtin_str[i]);
+    	printf("%d: %s\n", i, builtin_at(i)->name);
   	}
     printf("--------------------------------------------------\n");
 	return 1;
 }
 // ======================= requirement 2.1 =======================
-int cd(char **args)
+int cd(char **args, int *status)
 {
 	if (args[1] == NULL) {
 		fprintf(stderr, "shell: expected argument to \"cd\"\n");
+		*status = 1;
 		return 1;
 	}
-	chdir(args[1]);
+	if (chdir(args[1]) == -1) {
+		perror(args[1]);
+		*status = 1;
+	}
 	return 1;
 }
 // ===============================================================
 
-int pwd(char **args)
+int pwd(char **args, int *status)
 {
 	char cwd[BUF_SIZE];
     if (getcwd(cwd, sizeof(cwd)) != NULL) {
         printf("%s\n", cwd);
     } else {
         perror("pwd");
+        *status = 1;
     }
     return 1;
 }
 
-int echo(char **args)
+int echo(char **args, int *status)
 {
 	bool newline = true;
 	for (int i = 1; args[i]; ++i) {
@@ -93,12 +121,12 @@ int echo(char **args)
 	return 1;
 }
 
-int exit_shell(char **args)
+int exit_shell(char **args, int *status)
 {
 	return 0;
 }
 
-int record(char **args)
+int record(char **args, int *status)
 {
 	if (history_count < MAX_RECORD_NUM) {
 		for (int i = 0; i < history_count; ++i)
@@ -110,24 +138,185 @@ int record(char **args)
 	return 1;
 }
 
-const char *builtin_str[] = {
- 	"help",
- 	"cd",
-	"pwd",
-	"echo",
- 	"exit",
- 	"record",
-};
-
-const int (*builtin_func[]) (char **) = {
-	&help,
-	&cd,
-	&pwd,
-	&echo,
-	&exit_shell,
-  	&record,
-};
+/**
+ * @brief Run the external program of the same name, used when a built-in
+ * is given options it does not implement
+ * 
+ * @param args Arguments, args[0] is the program name
+ * @param status Set to the program's exit status
+ * @return int 
+ * Return 1, the shell keeps running
+ */
+static int run_external(char **args, int *status)
+{
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == -1) {
+		perror(args[0]);
+		*status = 1;
+		return 1;
+	}
+	if (pid == 0) {
+		supervise_child_signals();
+		execvp(args[0], args);
+		perror(args[0]);
+		_exit(127);
+	}
+	int wstatus;
+	while (waitpid(pid, &wstatus, 0) == -1)
+		;
+	*status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+	return 1;
+}
+
+static bool has_option(char **args)
+{
+	for (int i = 1; args[i]; ++i)
+		if (args[i][0] == '-' && args[i][1] != '\0')
+			return true;
+	return false;
+}
 
-int num_builtins() {
-	return sizeof(builtin_str) / sizeof(char *);
+int cat(char **args, int *status)
+{
+	if (has_option(args))
+		return run_external(args, status);
+
+	// data goes straight to fd 1, so anything printf()ed before must land first
+	fflush(stdout);
+	if (args[1] == NULL) {
+		if (copy_fd(STDIN_FILENO, STDOUT_FILENO) == -1) {
+			perror("cat");
+			*status = 1;
+		}
+		return 1;
+	}
+	for (int i = 1; args[i]; ++i) {
+		int fd = strcmp(args[i], "-") == 0 ? STDIN_FILENO : open(args[i], O_RDONLY);
+		if (fd == -1) {
+			perror(args[i]);
+			*status = 1;
+			continue;
+		}
+		if (copy_fd(fd, STDOUT_FILENO) == -1) {
+			perror(args[i]);
+			*status = 1;
+		}
+		if (fd != STDIN_FILENO)
+			close(fd);
+	}
+	return 1;
+}
+
+int cp(char **args, int *status)
+{
+	if (has_option(args) || args[1] == NULL || args[2] == NULL || args[3] != NULL)
+		return run_external(args, status);
+
+	char target[PATH_MAX];
+	struct stat st;
+	int in = open(args[1], O_RDONLY);
+	if (in == -1 || fstat(in, &st) == -1) {
+		perror(args[1]);
+		if (in != -1)
+			close(in);
+		*status = 1;
+		return 1;
+	}
+	if (S_ISDIR(st.st_mode)) {
+		fprintf(stderr, "cp: -r not specified; omitting directory '%s'\n", args[1]);
+		close(in);
+		*status = 1;
+		return 1;
+	}
+
+	// "cp file dir" copies into dir/file
+	struct stat dst;
+	strncpy(target, args[2], sizeof(target) - 1);
+	target[sizeof(target) - 1] = '\0';
+	if (stat(args[2], &dst) == 0 && S_ISDIR(dst.st_mode)) {
+		char src[PATH_MAX];
+		strncpy(src, args[1], sizeof(src) - 1);
+		src[sizeof(src) - 1] = '\0';
+		snprintf(target, sizeof(target), "%s/%s", args[2], basename(src));
+	}
+
+	if (stat(target, &dst) == 0 && dst.st_dev == st.st_dev && dst.st_ino == st.st_ino) {
+		fprintf(stderr, "cp: '%s' and '%s' are the same file\n", args[1], target);
+		close(in);
+		*status = 1;
+		return 1;
+	}
+
+	int out = open(target, O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 0777);
+	if (out == -1) {
+		perror(target);
+		close(in);
+		*status = 1;
+		return 1;
+	}
+	if (copy_fd(in, out) == -1) {
+		perror("cp");
+		*status = 1;
+	}
+	close(in);
+	close(out);
+	return 1;
+}
+
+/**
+ * @brief Shell options, currently only tracing
+ * "set -T file" starts writing a Chrome trace of every command to file,
+ * "set +T" finishes the trace
+ * @param args Arguments
+ * @param status Set to the command's exit status
+ * @return int 
+ * Return 1, the shell keeps running
+ */
+int set(char **args, int *status)
+{
+	if (args[1] == NULL) {
+		printf("trace %s\n", trace_enabled ? "on" : "off");
+	} else if (strcmp(args[1], "-T") == 0) {
+		if (args[2] == NULL) {
+			fprintf(stderr, "set: -T expects a file name\n");
+			*status = 2;
+		} else if (trace_start(args[2]) == -1) {
+			*status = 1;
+		}
+	} else if (strcmp(args[1], "+T") == 0) {
+		trace_stop();
+	} else {
+		fprintf(stderr, "set: unknown option %s\n", args[1]);
+		*status = 2;
+	}
+	return 1;
+}
+
+/**
+ * @brief "timeout N cmd ..." inside a pipeline stage, where it runs in the forked child:
+ * arm a timer that survives execvp() and become the command.
+ * At the start of a line the prefix is handled by the supervisor instead,
+ * which limits the whole pipeline.
+ * @param args Arguments
+ * @param status Set to the command's exit status
+ * @return int 
+ * Return 1, the shell keeps running
+ */
+int timeout_cmd(char **args, int *status)
+{
+	double secs = args[1] ? parse_duration(args[1]) : -1;
+	if (secs < 0 || args[2] == NULL) {
+		fprintf(stderr, "usage: timeout DURATION command [args...]\n");
+		*status = 2;
+		return 1;
+	}
+	struct itimerval it = { { 0, 0 }, { (time_t)secs, (suseconds_t)((secs - (time_t)secs) * 1e6) } };
+	if (it.it_value.tv_sec == 0 && it.it_value.tv_usec == 0)
+		it.it_value.tv_usec = 1;
+	setitimer(ITIMER_REAL, &it, NULL);
+	fflush(stdout);
+	execvp(args[2], args + 2);
+	perror(args[2]);
+	_exit(127);
 }
@@ -3,23 +3,37 @@
 #include <stdbool.h>
 #include <string.h>
 #include "../include/command.h"
+#include "../include/lineedit.h"
 
 /**
  * @brief Read the user's input string
- * 
+ * On a terminal the line editor reads it, otherwise a plain fgets()
+ * @param prompt Prompt to show
+ * @param eof Set at end of input, to tell it apart from a blank line
  * @return char* 
  * Return string
  */
-char *read_line()
+char *read_line(const char *prompt, bool *eof)
 {
-    char *buffer = (char *)malloc(BUF_SIZE * sizeof(char));
-    if (buffer == NULL) {
-        perror("Unable to allocate buffer");
-        exit(1);
-    }
+	char *buffer;
+	if (line_edit_enabled) {
+		buffer = line_edit(prompt, eof);
+	} else {
+		printf("%s", prompt);
+		buffer = (char *)malloc(BUF_SIZE * sizeof(char));
+		if (buffer == NULL) {
+			perror("Unable to allocate buffer");
+			exit(1);
+		}
+		if (fgets(buffer, BUF_SIZE, stdin) == NULL) {
+			free(buffer);
+			buffer = NULL;
+		}
+		*eof = feof(stdin);
+	}
 
-	if (fgets(buffer, BUF_SIZE, stdin) != NULL) {
-		if (buffer[0] == '\n' || buffer[0] == ' ' || buffer[0] == '\t') {
+	if (buffer != NULL) {
+		if (buffer[strspn(buffer, " \t\n")] == '\0') {
 			free(buffer);
 			buffer = NULL;
 		} 
@@ -33,6 +47,22 @@ char *read_line()
 	return buffer;
 }
 
+/**
+ * @brief Allocate an empty cmd_node reading stdin and writing stdout
+ * 
+ * @param args_length Capacity of the args array
+ * @return struct cmd_node* 
+ */
+struct cmd_node *new_cmd_node(int args_length)
+{
+	struct cmd_node *node = (struct cmd_node *)calloc(1, sizeof(struct cmd_node));
+	node->args = (char **)calloc(args_length + 1, sizeof(char *));
+	node->in  = 0;
+	node->out = 1;
+	node->pid = -1;
+	return node;
+}
+
 /**
  * @brief Parse the user's command
  * 
@@ -43,29 +73,19 @@ char *read_line()
 struct cmd *split_line(char *line)
 {
 	int args_length = 10;
-    struct cmd *new_cmd = (struct cmd *)malloc(sizeof(struct cmd));
-    new_cmd->head = (struct cmd_node *)malloc(sizeof(struct cmd_node));
-    new_cmd->head->args = (char **)malloc(args_length * sizeof(char *));
-	for (int i = 0; i < args_length; ++i)
-		new_cmd->head->args[i] = NULL;
-    new_cmd->head->length = 0;
-    new_cmd->head->next = NULL;
-	new_cmd->pipe_num = 0;
+    struct cmd *new_cmd = (struct cmd *)calloc(1, sizeof(struct cmd));
+    new_cmd->head = new_cmd_node(args_length);
 
 	struct cmd_node *temp = new_cmd->head;
-	temp->in_file 	= NULL;
-	temp->out_file 	= NULL;
-	temp->in       	= 0;
-	temp->out 		= 1;
     char *token = strtok(line, " ");
+	// "time" prefix: report resource usage once the command finishes
+	if (token != NULL && strcmp(token, "time") == 0) {
+		new_cmd->timed = true;
+		token = strtok(NULL, " ");
+	}
     while (token != NULL) {
         if (token[0] == '|') {
-            struct cmd_node *new_pipe = (struct cmd_node *)malloc(sizeof(struct cmd_node));
-			new_pipe->args = (char **)malloc(args_length * sizeof(char *));
-			for (int i = 0; i < args_length; ++i)
-				new_pipe->args[i] = NULL;
-			new_pipe->length = 0;
-			new_pipe->next = NULL;
+            struct cmd_node *new_pipe = new_cmd_node(args_length);
 			temp->next = new_pipe;
 			temp = new_pipe;
         } else if (token[0] == '<') {
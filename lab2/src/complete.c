@@ -0,0 +1,294 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "../include/complete.h"
+#include "../include/builtin.h"
+
+/*
+ * Command-name index for Tab completion: a trie of every executable in
+ * $PATH plus the built-ins, built once and then kept current from inotify
+ * events instead of rescanning the directories on each Tab.
+ * Each node records which PATH directories hold an executable of that name
+ * (one bit per directory), so a name disappears only when the last copy
+ * does, and how many names end below it, so counting matches and finding
+ * the common extension never walk more than the prefix.
+ */
+
+struct trie_node {
+	int child;		// first child, 0 for none (the root is never a child)
+	int sibling;	// next child of the same parent, ordered by ch
+	int count;		// names ending in this subtree
+	uint64_t dirs;	// bit i: PATH directory i holds this executable
+	bool builtin;
+	char ch;
+};
+
+static struct trie_node *pool;
+static int pool_used, pool_size;
+
+static int inotify_fd = -1;
+static int dir_count;
+static struct {
+	int wd;
+	char *path;
+} dirs[COMPLETE_MAX_DIRS];
+
+static int new_node(char ch)
+{
+	if (pool_used == pool_size) {
+		pool_size = pool_size ? pool_size * 2 : 4096;
+		pool = (struct trie_node *)realloc(pool, pool_size * sizeof(struct trie_node));
+	}
+	memset(&pool[pool_used], 0, sizeof(struct trie_node));
+	pool[pool_used].ch = ch;
+	return pool_used++;
+}
+
+static int find_child(int node, char ch, bool create)
+{
+	int *link = &pool[node].child;
+	while (*link && pool[*link].ch < ch)
+		link = &pool[*link].sibling;
+	if (*link && pool[*link].ch == ch)
+		return *link;
+	if (!create)
+		return 0;
+	int n = new_node(ch);
+	// new_node() may have moved the pool
+	link = &pool[node].child;
+	while (*link && pool[*link].ch < ch)
+		link = &pool[*link].sibling;
+	pool[n].sibling = *link;
+	*link = n;
+	return n;
+}
+
+static bool is_name(const struct trie_node *n)
+{
+	return n->dirs || n->builtin;
+}
+
+/**
+ * @brief Add or remove one source (a PATH directory bit, or the built-in flag) of a name
+ *
+ * @param name Command name
+ * @param bit PATH directory index, -1 for the built-in flag
+ * @param present Whether the name now exists in that source
+ */
+static void trie_mark(const char *name, int bit, bool present)
+{
+	int path[NAME_MAX + 2], depth = 0, node = 0;
+	path[depth++] = 0;
+	for (const char *c = name; *c && depth < NAME_MAX + 1; ++c) {
+		node = find_child(node, *c, present);
+		if (node == 0)
+			return;
+		path[depth++] = node;
+	}
+	struct trie_node *n = &pool[node];
+	bool was = is_name(n);
+	if (bit < 0)
+		n->builtin = present;
+	else if (present)
+		n->dirs |= 1ull << bit;
+	else
+		n->dirs &= ~(1ull << bit);
+	bool now = is_name(n);
+	if (was != now)
+		for (int i = 0; i < depth; ++i)
+			pool[path[i]].count += now ? 1 : -1;
+}
+
+static bool executable(const char *dir, const char *name)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	return stat(path, &st) == 0 && S_ISREG(st.st_mode) && (st.st_mode & 0111);
+}
+
+static void scan_dir(int bit)
+{
+	DIR *d = opendir(dirs[bit].path);
+	if (d == NULL)
+		return;
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL) {
+		if (ent->d_name[0] == '.' || ent->d_type == DT_DIR)
+			continue;
+		if (executable(dirs[bit].path, ent->d_name))
+			trie_mark(ent->d_name, bit, true);
+	}
+	closedir(d);
+}
+
+/**
+ * @brief Build the index from $PATH and the built-ins and start watching the directories.
+ * Also used to start over when inotify loses track (queue overflow, a directory removed).
+ */
+void complete_init(void)
+{
+	if (inotify_fd != -1)
+		close(inotify_fd);
+	for (int i = 0; i < dir_count; ++i)
+		free(dirs[i].path);
+	dir_count = 0;
+	pool_used = 0;
+	new_node('\0');
+
+	for (int i = 0; i < num_builtins(); ++i)
+		trie_mark(builtin_at(i)->name, -1, true);
+
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	const char *env = getenv("PATH");
+	char *path = strdup(env ? env : "/usr/local/bin:/usr/bin:/bin");
+	char *save;
+	for (char *dir = strtok_r(path, ":", &save); dir; dir = strtok_r(NULL, ":", &save)) {
+		if (dir_count == COMPLETE_MAX_DIRS)
+			break;
+		int wd = -1;
+		if (inotify_fd != -1) {
+			wd = inotify_add_watch(inotify_fd, dir, IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+					IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF |
+					IN_ONLYDIR);
+			if (wd == -1)
+				continue;	// missing directory
+		}
+		bool seen = false;
+		for (int i = 0; i < dir_count; ++i)
+			seen |= (wd != -1 && dirs[i].wd == wd) || strcmp(dirs[i].path, dir) == 0;
+		if (seen)
+			continue;
+		dirs[dir_count].wd = wd;
+		dirs[dir_count].path = strdup(dir);
+		scan_dir(dir_count++);
+	}
+	free(path);
+}
+
+/**
+ * @brief Apply pending inotify events to the index, called before every lookup
+ */
+void complete_refresh(void)
+{
+	char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	if (inotify_fd == -1)
+		return;
+	while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+		for (char *p = buf; p < buf + len; ) {
+			struct inotify_event *ev = (struct inotify_event *)p;
+			p += sizeof(struct inotify_event) + ev->len;
+			if (ev->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF)) {
+				complete_init();
+				return;
+			}
+			int bit = 0;
+			while (bit < dir_count && dirs[bit].wd != ev->wd)
+				++bit;
+			if (bit == dir_count || ev->len == 0 || ev->name[0] == '.')
+				continue;
+			if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+				trie_mark(ev->name, bit, false);
+			else
+				trie_mark(ev->name, bit, executable(dirs[bit].path, ev->name));
+		}
+	}
+}
+
+static int find_prefix(const char *prefix, size_t len)
+{
+	int node = 0;
+	for (size_t i = 0; i < len; ++i) {
+		node = find_child(node, prefix[i], false);
+		if (node == 0)
+			return -1;
+	}
+	return pool[node].count ? node : -1;
+}
+
+/**
+ * @brief Complete a command name
+ *
+ * @param prefix What has been typed so far
+ * @param len Length of prefix
+ * @param extension Set to the characters every match shares after the prefix (malloc'd)
+ * @return int
+ * Return the number of matching commands
+ */
+int complete_lookup(const char *prefix, size_t len, char **extension)
+{
+	complete_refresh();
+	int node = find_prefix(prefix, len);
+	int matches = node == -1 ? 0 : pool[node].count;
+	size_t n = 0, cap = 16;
+	char *ext = (char *)malloc(cap);
+	if (node != -1) {
+		// follow the only live child until names branch or one ends
+		while (!is_name(&pool[node])) {
+			int only = 0, live = 0;
+			for (int c = pool[node].child; c; c = pool[c].sibling)
+				if (pool[c].count) {
+					only = c;
+					++live;
+				}
+			if (live != 1)
+				break;
+			if (n + 1 == cap)
+				ext = (char *)realloc(ext, cap *= 2);
+			ext[n++] = pool[only].ch;
+			node = only;
+		}
+	}
+	ext[n] = '\0';
+	*extension = ext;
+	return matches;
+}
+
+static void collect(int node, char *name, size_t depth, char **out, int limit, int *n)
+{
+	if (*n == limit)
+		return;
+	if (is_name(&pool[node])) {
+		name[depth] = '\0';
+		out[(*n)++] = strdup(name);
+	}
+	for (int c = pool[node].child; c && *n < limit; c = pool[c].sibling) {
+		if (pool[c].count == 0 || depth + 1 >= NAME_MAX + 1)
+			continue;
+		name[depth] = pool[c].ch;
+		collect(c, name, depth + 1, out, limit, n);
+	}
+}
+
+/**
+ * @brief List matching command names in sorted order
+ *
+ * @param prefix What has been typed so far
+ * @param len Length of prefix
+ * @param out Receives up to limit malloc'd names
+ * @param limit Size of out
+ * @return int
+ * Return the number of names stored in out
+ */
+int complete_matches(const char *prefix, size_t len, char **out, int limit)
+{
+	char name[NAME_MAX + 1];
+	int n = 0;
+	complete_refresh();
+	int node = find_prefix(prefix, len);
+	if (node == -1 || len > NAME_MAX)
+		return 0;
+	memcpy(name, prefix, len);
+	collect(node, name, len, out, limit, &n);
+	return n;
+}
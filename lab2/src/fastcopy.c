@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "../include/fastcopy.h"
+
+#define CHUNK_SIZE (1 << 30)
+#define BUF_SIZE_COPY (64 * 1024)
+
+// errors meaning "this mechanism does not work for these fds", not a real I/O failure
+static bool unsupported(int err)
+{
+	return err == EINVAL || err == ENOSYS || err == EXDEV || err == EOPNOTSUPP || err == EBADF;
+}
+
+/**
+ * @brief Move data between two descriptors with splice(), one side must be a pipe
+ * 
+ * @return ssize_t 
+ * Bytes copied, or -1 with errno set if nothing could be copied
+ */
+static ssize_t copy_splice(int in, int out)
+{
+	ssize_t total = 0, n;
+	while ((n = splice(in, NULL, out, NULL, CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE)) > 0)
+		total += n;
+	if (n == -1 && (total == 0 || !unsupported(errno)))
+		return -1;
+	return total;
+}
+
+/**
+ * @brief Copy between two regular files inside the kernel (reflink when the filesystem can)
+ */
+static ssize_t copy_range(int in, int out)
+{
+	ssize_t total = 0, n;
+	while ((n = copy_file_range(in, NULL, out, NULL, CHUNK_SIZE, 0)) > 0)
+		total += n;
+	if (n == -1 && (total == 0 || !unsupported(errno)))
+		return -1;
+	return total;
+}
+
+/**
+ * @brief Copy from a regular file to any descriptor with sendfile()
+ */
+static ssize_t copy_sendfile(int in, int out)
+{
+	ssize_t total = 0, n;
+	while ((n = sendfile(out, in, NULL, CHUNK_SIZE)) > 0)
+		total += n;
+	if (n == -1 && (total == 0 || !unsupported(errno)))
+		return -1;
+	return total;
+}
+
+static ssize_t copy_rw(int in, int out)
+{
+	char buf[BUF_SIZE_COPY];
+	ssize_t total = 0, n;
+	while ((n = read(in, buf, sizeof(buf))) > 0) {
+		for (ssize_t off = 0; off < n; ) {
+			ssize_t w = write(out, buf + off, n - off);
+			if (w == -1) {
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			off += w;
+		}
+		total += n;
+	}
+	return n == -1 ? -1 : total;
+}
+
+/**
+ * @brief 
+ * Copy everything readable from "in" to "out" without passing the data through userspace
+ * when possible:
+ * 1. splice() if either side is a pipe
+ * 2. copy_file_range() if both sides are regular files
+ * 3. sendfile() if the source is a regular file
+ * 4. read()/write() otherwise, or when the kernel refuses the descriptors
+ * Each step resumes from the current file offsets, so a method that gives up
+ * part way through is continued by the next one.
+ * @param in Source file descriptor
+ * @param out Destination file descriptor
+ * @return ssize_t 
+ * Bytes copied, or -1 on error
+ */
+ssize_t copy_fd(int in, int out)
+{
+	struct stat in_st, out_st;
+	ssize_t total = 0, n;
+
+	if (fstat(in, &in_st) == -1 || fstat(out, &out_st) == -1)
+		return -1;
+
+	if (S_ISFIFO(in_st.st_mode) || S_ISFIFO(out_st.st_mode)) {
+		if ((n = copy_splice(in, out)) == -1 && !unsupported(errno))
+			return -1;
+		total += n > 0 ? n : 0;
+	} else if (S_ISREG(in_st.st_mode) && S_ISREG(out_st.st_mode)) {
+		if ((n = copy_range(in, out)) == -1 && !unsupported(errno))
+			return -1;
+		total += n > 0 ? n : 0;
+	}
+	if (S_ISREG(in_st.st_mode)) {
+		if ((n = copy_sendfile(in, out)) == -1 && !unsupported(errno))
+			return -1;
+		total += n > 0 ? n : 0;
+	}
+	if ((n = copy_rw(in, out)) == -1)
+		return -1;
+	return total + n;
+}
@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include "../include/lineedit.h"
+#include "../include/complete.h"
+#include "../include/command.h"
+
+/*
+ * Single-line editor for an interactive psh: the terminal is put in raw
+ * mode only while a line is being read. Supports cursor movement, the usual
+ * Emacs-style kill keys, history from the record ring and Tab completion of
+ * command names from the completion index.
+ */
+
+#define CTRL_KEY(c) ((c) & 0x1f)
+// more matches than this are counted but not listed
+#define LIST_LIMIT 200
+
+bool line_edit_enabled;
+static struct termios cooked;
+
+struct line {
+	char buf[BUF_SIZE];
+	size_t len, pos;
+	const char *prompt;
+	bool listed;	// the last Tab was ambiguous, so another one lists the matches
+};
+
+/**
+ * @brief Turn the editor on when stdin and stdout are a terminal, and build the completion index
+ */
+void line_edit_init(void)
+{
+	const char *term = getenv("TERM");
+	if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || (term && strcmp(term, "dumb") == 0))
+		return;
+	if (tcgetattr(STDIN_FILENO, &cooked) == -1)
+		return;
+	line_edit_enabled = true;
+	complete_init();
+}
+
+static void write_str(const char *s, size_t n)
+{
+	while (n > 0) {
+		ssize_t w = write(STDOUT_FILENO, s, n);
+		if (w <= 0)
+			return;
+		s += w;
+		n -= w;
+	}
+}
+
+static int columns(void)
+{
+	struct winsize ws;
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0)
+		return 80;
+	return ws.ws_col;
+}
+
+// redraw the prompt and the part of the line that fits, scrolling sideways around the cursor
+static void refresh(struct line *l)
+{
+	size_t plen = strlen(l->prompt), cols = columns();
+	size_t start = 0, len = l->len;
+	while (start < l->pos && plen + l->pos - start >= cols)
+		++start;
+	if (cols > plen && plen + len - start > cols)
+		len = start + cols - plen;
+
+	char seq[64];
+	size_t col = plen + l->pos - start;
+	write_str("\r", 1);
+	write_str(l->prompt, plen);
+	write_str(l->buf + start, len - start);
+	write_str("\x1b[0K\r", 5);
+	if (col > 0)
+		write_str(seq, snprintf(seq, sizeof(seq), "\x1b[%zuC", col));
+}
+
+static void insert(struct line *l, const char *s, size_t n)
+{
+	if (l->len + n >= BUF_SIZE)
+		return;
+	memmove(l->buf + l->pos + n, l->buf + l->pos, l->len - l->pos);
+	memcpy(l->buf + l->pos, s, n);
+	l->pos += n;
+	l->len += n;
+}
+
+static void erase(struct line *l, size_t from, size_t to)
+{
+	memmove(l->buf + from, l->buf + to, l->len - to);
+	l->len -= to - from;
+	if (l->pos > to)
+		l->pos -= to - from;
+	else if (l->pos > from)
+		l->pos = from;
+}
+
+// a word is in command position after the start of the line, "|", ";", "&&", "||" or a keyword
+static bool command_position(const struct line *l, size_t start)
+{
+	size_t i = start;
+	while (i > 0 && (l->buf[i - 1] == ' ' || l->buf[i - 1] == '\t'))
+		--i;
+	if (i == 0 || strchr("|;&(", l->buf[i - 1]))
+		return true;
+	static const char *const keywords[] = { "then", "else", "do", "if", "elif", "while", "until", "time" };
+	for (size_t k = 0; k < sizeof(keywords) / sizeof(keywords[0]); ++k) {
+		size_t n = strlen(keywords[k]);
+		if (i >= n && strncmp(l->buf + i - n, keywords[k], n) == 0 &&
+				(i == n || strchr(" \t;|&", l->buf[i - n - 1])))
+			return true;
+	}
+	return false;
+}
+
+static void list_matches(const char *prefix, size_t len, int total)
+{
+	char *names[LIST_LIMIT];
+	int n = complete_matches(prefix, len, names, LIST_LIMIT);
+	size_t width = 0;
+	for (int i = 0; i < n; ++i)
+		if (strlen(names[i]) > width)
+			width = strlen(names[i]);
+	width += 2;
+	int per_row = columns() / width;
+	if (per_row < 1)
+		per_row = 1;
+
+	write_str("\r\n", 2);
+	for (int i = 0; i < n; ++i) {
+		char cell[BUF_SIZE];
+		int w = snprintf(cell, sizeof(cell), "%-*s", (int)width, names[i]);
+		write_str(cell, w);
+		if ((i + 1) % per_row == 0 || i + 1 == n)
+			write_str("\r\n", 2);
+		free(names[i]);
+	}
+	if (total > n) {
+		char more[64];
+		int w = snprintf(more, sizeof(more), "... and %d more\r\n", total - n);
+		write_str(more, w);
+	}
+}
+
+static void complete(struct line *l)
+{
+	size_t start = l->pos;
+	while (start > 0 && !strchr(" \t|;&<>(", l->buf[start - 1]))
+		--start;
+	// only command names are indexed; paths are left to the user
+	if (!command_position(l, start) || memchr(l->buf + start, '/', l->pos - start)) {
+		write_str("\a", 1);
+		return;
+	}
+	char *ext;
+	int matches = complete_lookup(l->buf + start, l->pos - start, &ext);
+	bool listed = false;
+	if (matches == 0) {
+		write_str("\a", 1);
+	} else if (matches == 1) {
+		insert(l, ext, strlen(ext));
+		insert(l, " ", 1);
+	} else if (ext[0]) {
+		insert(l, ext, strlen(ext));
+		listed = true;	// still ambiguous, the next Tab lists the matches
+	} else if (l->listed) {
+		list_matches(l->buf + start, l->pos - start, matches);
+	} else {
+		write_str("\a", 1);
+		listed = true;
+	}
+	free(ext);
+	l->listed = listed;
+}
+
+static void load_history(struct line *l, int index)
+{
+	strncpy(l->buf, history[index % MAX_RECORD_NUM], BUF_SIZE - 1);
+	l->buf[BUF_SIZE - 1] = '\0';
+	l->len = l->pos = strlen(l->buf);
+}
+
+/**
+ * @brief Read one line from the terminal with editing
+ *
+ * @param prompt Prompt shown in front of the line
+ * @param eof Set when Ctrl-D ends the input on an empty line
+ * @return char*
+ * Return the line without its newline (malloc'd), or NULL at end of input
+ */
+char *line_edit(const char *prompt, bool *eof)
+{
+	struct line l = { .prompt = prompt };
+	// history_count is the line being typed, older entries count down from it
+	int hist = history_count, oldest = history_count > MAX_RECORD_NUM ? history_count - MAX_RECORD_NUM : 0;
+	char saved[BUF_SIZE] = "";
+	*eof = false;
+
+	struct termios raw = cooked;
+	raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+	raw.c_oflag &= ~OPOST;
+	raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	fflush(stdout);
+	tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+	refresh(&l);
+
+	bool done = false;
+	while (!done) {
+		char c;
+		if (read(STDIN_FILENO, &c, 1) != 1) {
+			*eof = true;
+			break;
+		}
+		if (c != '\t')
+			l.listed = false;
+		switch (c) {
+		case '\r':
+		case '\n':
+			done = true;
+			break;
+		case CTRL_KEY('C'):
+			write_str("^C", 2);
+			l.len = l.pos = 0;
+			done = true;
+			break;
+		case CTRL_KEY('D'):
+			if (l.len == 0) {
+				*eof = true;
+				done = true;
+			} else if (l.pos < l.len) {
+				erase(&l, l.pos, l.pos + 1);
+			}
+			break;
+		case '\t':
+			complete(&l);
+			break;
+		case 127:
+		case CTRL_KEY('H'):
+			if (l.pos > 0)
+				erase(&l, l.pos - 1, l.pos);
+			break;
+		case CTRL_KEY('A'): l.pos = 0; break;
+		case CTRL_KEY('E'): l.pos = l.len; break;
+		case CTRL_KEY('B'): if (l.pos > 0) --l.pos; break;
+		case CTRL_KEY('F'): if (l.pos < l.len) ++l.pos; break;
+		case CTRL_KEY('U'): erase(&l, 0, l.pos); break;
+		case CTRL_KEY('K'): l.len = l.pos; break;
+		case CTRL_KEY('W'): {
+			size_t from = l.pos;
+			while (from > 0 && l.buf[from - 1] == ' ')
+				--from;
+			while (from > 0 && l.buf[from - 1] != ' ')
+				--from;
+			erase(&l, from, l.pos);
+			break;
+		}
+		case CTRL_KEY('L'):
+			write_str("\x1b[H\x1b[2J", 7);
+			break;
+		case CTRL_KEY('P'):
+		case CTRL_KEY('N'):
+		case '\x1b': {
+			char key = c;
+			if (c == '\x1b') {
+				char seq[3];
+				if (read(STDIN_FILENO, seq, 1) != 1 || read(STDIN_FILENO, seq + 1, 1) != 1)
+					break;
+				if (seq[0] != '[' && seq[0] != 'O')
+					break;
+				if (seq[1] >= '0' && seq[1] <= '9') {
+					if (read(STDIN_FILENO, seq + 2, 1) != 1 || seq[2] != '~')
+						break;
+					if (seq[1] == '3' && l.pos < l.len)
+						erase(&l, l.pos, l.pos + 1);
+					else if (seq[1] == '1' || seq[1] == '7')
+						l.pos = 0;
+					else if (seq[1] == '4' || seq[1] == '8')
+						l.pos = l.len;
+					break;
+				}
+				switch (seq[1]) {
+				case 'A': key = CTRL_KEY('P'); break;
+				case 'B': key = CTRL_KEY('N'); break;
+				case 'C': if (l.pos < l.len) ++l.pos; break;
+				case 'D': if (l.pos > 0) --l.pos; break;
+				case 'H': l.pos = 0; break;
+				case 'F': l.pos = l.len; break;
+				}
+			}
+			if (key == CTRL_KEY('P') && hist > oldest) {
+				if (hist == history_count) {
+					memcpy(saved, l.buf, l.len);
+					saved[l.len] = '\0';
+				}
+				load_history(&l, --hist);
+			} else if (key == CTRL_KEY('N') && hist < history_count) {
+				if (++hist == history_count) {
+					strcpy(l.buf, saved);
+					l.len = l.pos = strlen(saved);
+				} else {
+					load_history(&l, hist);
+				}
+			}
+			break;
+		}
+		default:
+			if ((unsigned char)c >= ' ')
+				insert(&l, &c, 1);
+			break;
+		}
+		if (!done)
+			refresh(&l);
+	}
+	write_str("\r\n", 2);
+	tcsetattr(STDIN_FILENO, TCSAFLUSH, &cooked);
+
+	if (*eof)
+		return NULL;
+	l.buf[l.len] = '\0';
+	return strdup(l.buf);
+}
@@ -0,0 +1,1141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include "../include/script.h"
+#include "../include/shell.h"
+#include "../include/arith.h"
+#include "../include/vars.h"
+#include "../include/supervise.h"
+#include "../include/trace.h"
+#include "../include/affinity.h"
+
+/*
+ * Scripting layer of psh: variables, $(( )) arithmetic and if/while/until/for.
+ * A complete input (one line, or several for an unfinished loop) is parsed
+ * once into a tree; words keep their $NAME and $(( )) parts pre-compiled with
+ * the variable slots already resolved, so running a loop body a million times
+ * never re-reads or re-tokenises the text. Only external commands fork.
+ */
+
+// ============================ AST ============================
+
+enum part_type { P_LIT, P_VAR, P_STATUS, P_ARITH };
+
+struct word_part {
+	enum part_type type;
+	bool quoted;		// inside "..." : the expansion is not field split
+	char *lit;
+	struct var *var;
+	struct arith *arith;
+	struct word_part *next;
+};
+
+struct word {
+	struct word_part *parts;
+	bool quoted;		// contains quotes, so it yields a field even when empty
+	struct word *next;
+};
+
+struct stage {
+	struct word *words;
+	struct word *in_file, *out_file;
+	struct stage *next;
+};
+
+struct assign {
+	struct var *var;
+	struct word *value;
+	struct assign *next;
+};
+
+enum node_type { N_CMD, N_ARITH, N_LIST, N_AND, N_OR, N_IF, N_WHILE, N_UNTIL, N_FOR, N_FOR_ARITH };
+
+struct script_node {
+	enum node_type type;
+	struct stage *stages;		// N_CMD
+	struct assign *assigns;		// N_CMD
+	struct arith *arith[3];		// N_ARITH: expression, N_FOR_ARITH: init; cond; step
+	struct var *var;			// N_FOR
+	struct word *words;			// N_FOR
+	struct script_node *a, *b, *c;
+};
+
+static void word_free(struct word *w)
+{
+	while (w) {
+		struct word *next = w->next;
+		for (struct word_part *p = w->parts; p; ) {
+			struct word_part *pn = p->next;
+			free(p->lit);
+			arith_free(p->arith);
+			free(p);
+			p = pn;
+		}
+		free(w);
+		w = next;
+	}
+}
+
+void script_free(struct script_node *node)
+{
+	if (node == NULL)
+		return;
+	for (struct stage *s = node->stages; s; ) {
+		struct stage *next = s->next;
+		word_free(s->words);
+		word_free(s->in_file);
+		word_free(s->out_file);
+		free(s);
+		s = next;
+	}
+	for (struct assign *as = node->assigns; as; ) {
+		struct assign *next = as->next;
+		word_free(as->value);
+		free(as);
+		as = next;
+	}
+	for (int i = 0; i < 3; ++i)
+		arith_free(node->arith[i]);
+	word_free(node->words);
+	script_free(node->a);
+	script_free(node->b);
+	script_free(node->c);
+	free(node);
+}
+
+static struct script_node *new_node(enum node_type type)
+{
+	struct script_node *node = (struct script_node *)calloc(1, sizeof(struct script_node));
+	node->type = type;
+	return node;
+}
+
+// ============================ lexer ============================
+
+enum tok_type { T_WORD, T_ARITH, T_SEMI, T_NEWLINE, T_PIPE, T_AND, T_OR, T_LESS, T_GREAT, T_EOF, T_ERROR };
+
+struct token {
+	enum tok_type type;
+	const char *start;	// T_WORD: raw text, T_ARITH: text between (( and ))
+	size_t len;
+};
+
+struct lexer {
+	const char *p;
+	struct token tok;
+	bool peeked;
+	enum script_status status;
+	const char *error;
+};
+
+static void lex_fail(struct lexer *lx, enum script_status status, const char *error)
+{
+	if (lx->status == SCRIPT_OK) {
+		lx->status = status;
+		lx->error = error;
+	}
+}
+
+// skip "((...))" starting at s, return the char after "))", or NULL with
+// *status SCRIPT_INCOMPLETE if unterminated, SCRIPT_ERROR if the closing
+// parentheses are not a "))" pair, e.g. "(( 1 ) )"
+static const char *skip_arith(const char *s, enum script_status *status)
+{
+	int depth = 0;
+	for (; *s; ++s) {
+		if (*s == '(')
+			++depth;
+		else if (*s == ')' && --depth == 0) {
+			if (s[-1] == ')')
+				return s + 1;
+			*status = SCRIPT_ERROR;
+			return NULL;
+		}
+	}
+	*status = SCRIPT_INCOMPLETE;
+	return NULL;
+}
+
+// end of a word starting at s: stops at unquoted blanks and operators
+static const char *scan_word(struct lexer *lx, const char *s)
+{
+	while (*s && !strchr(" \t\n;|&<>", *s)) {
+		if (*s == '\'') {
+			const char *q = strchr(s + 1, '\'');
+			if (q == NULL) {
+				lex_fail(lx, SCRIPT_INCOMPLETE, "unterminated quote");
+				return NULL;
+			}
+			s = q + 1;
+		} else if (*s == '"') {
+			for (++s; *s && *s != '"'; ++s)
+				if (*s == '\\' && s[1])
+					++s;
+			if (*s == '\0') {
+				lex_fail(lx, SCRIPT_INCOMPLETE, "unterminated quote");
+				return NULL;
+			}
+			++s;
+		} else if (*s == '\\') {
+			s += s[1] ? 2 : 1;
+		} else if (s[0] == '$' && s[1] == '(' && s[2] == '(') {
+			enum script_status status;
+			const char *end = skip_arith(s + 1, &status);
+			if (end == NULL) {
+				lex_fail(lx, status, status == SCRIPT_ERROR ? "expected '))'" : "unterminated $((");
+				return NULL;
+			}
+			s = end;
+		} else if (s[0] == '$' && s[1] == '{') {
+			const char *end = strchr(s, '}');
+			if (end == NULL) {
+				lex_fail(lx, SCRIPT_ERROR, "missing '}'");
+				return NULL;
+			}
+			s = end + 1;
+		} else {
+			++s;
+		}
+	}
+	return s;
+}
+
+static struct token *lex_peek(struct lexer *lx)
+{
+	if (lx->peeked)
+		return &lx->tok;
+	lx->peeked = true;
+
+	const char *s = lx->p;
+	while (*s == ' ' || *s == '\t')
+		++s;
+	if (*s == '#')
+		while (*s && *s != '\n')
+			++s;
+
+	struct token *t = &lx->tok;
+	t->start = s;
+	t->len = 1;
+	switch (*s) {
+	case '\0':
+		t->type = T_EOF;
+		t->len = 0;
+		break;
+	case '\n':
+		t->type = T_NEWLINE;
+		break;
+	case ';':
+		t->type = T_SEMI;
+		break;
+	case '<':
+		t->type = T_LESS;
+		break;
+	case '>':
+		t->type = T_GREAT;
+		break;
+	case '|':
+		t->type = s[1] == '|' ? T_OR : T_PIPE;
+		t->len = s[1] == '|' ? 2 : 1;
+		break;
+	case '&':
+		if (s[1] == '&') {
+			t->type = T_AND;
+			t->len = 2;
+		} else {
+			t->type = T_ERROR;
+			lex_fail(lx, SCRIPT_ERROR, "background jobs are not supported");
+		}
+		break;
+	default:
+		if (s[0] == '(' && s[1] == '(') {
+			enum script_status status;
+			const char *end = skip_arith(s, &status);
+			if (end == NULL) {
+				t->type = T_ERROR;
+				lex_fail(lx, status, status == SCRIPT_ERROR ? "expected '))'" : "unterminated ((");
+				break;
+			}
+			t->type = T_ARITH;
+			t->start = s + 2;
+			t->len = end - s - 4;
+			lx->p = end;
+			return t;
+		}
+		const char *end = scan_word(lx, s);
+		if (end == NULL) {
+			t->type = T_ERROR;
+			break;
+		}
+		t->type = T_WORD;
+		t->len = end - s;
+	}
+	lx->p = t->start + t->len;
+	return t;
+}
+
+static struct token *lex_next(struct lexer *lx)
+{
+	struct token *t = lex_peek(lx);
+	lx->peeked = false;
+	return t;
+}
+
+static bool is_keyword(struct token *t, const char *kw)
+{
+	return t->type == T_WORD && strlen(kw) == t->len && strncmp(t->start, kw, t->len) == 0;
+}
+
+// ============================ words ============================
+
+static struct word_part *add_part(struct word_part ***tail, enum part_type type, bool quoted)
+{
+	struct word_part *p = (struct word_part *)calloc(1, sizeof(struct word_part));
+	p->type = type;
+	p->quoted = quoted;
+	**tail = p;
+	*tail = &p->next;
+	return p;
+}
+
+/**
+ * @brief Compile the raw text of a word into literal and expansion parts,
+ * removing quotes and backslashes
+ *
+ * @return struct word*
+ * Return the compiled word, or NULL on error
+ */
+static struct word *compile_word(struct lexer *lx, const char *s, size_t len)
+{
+	struct word *w = (struct word *)calloc(1, sizeof(struct word));
+	struct word_part **tail = &w->parts;
+	const char *end = s + len;
+	char *lit = (char *)malloc(len + 1);
+	size_t n = 0;
+	bool dq = false;
+
+#define FLUSH_LIT() do { \
+		if (n > 0) { \
+			add_part(&tail, P_LIT, true)->lit = strndup(lit, n); \
+			n = 0; \
+		} \
+	} while (0)
+
+	while (s < end) {
+		if (*s == '\'' && !dq) {
+			w->quoted = true;
+			for (++s; *s != '\''; ++s)
+				lit[n++] = *s;
+			++s;
+		} else if (*s == '"') {
+			w->quoted = true;
+			dq = !dq;
+			++s;
+		} else if (*s == '\\' && s + 1 < end) {
+			if (dq && !strchr("$\"\\", s[1]))
+				lit[n++] = '\\';
+			lit[n++] = s[1];
+			s += 2;
+		} else if (*s == '$' && s[1] == '(' && s[2] == '(') {
+			enum script_status status;
+			const char *close = skip_arith(s + 1, &status);     // scan_word() checked it
+			const char *error;
+			char *expr = strndup(s + 3, close - s - 5);
+			struct arith *a = arith_parse(expr, &error);
+			free(expr);
+			if (a == NULL) {
+				lex_fail(lx, SCRIPT_ERROR, error);
+				free(lit);
+				word_free(w);
+				return NULL;
+			}
+			FLUSH_LIT();
+			add_part(&tail, P_ARITH, dq)->arith = a;
+			s = close;
+		} else if (*s == '$' && (s[1] == '{' || s[1] == '_' || isalpha((unsigned char)s[1]))) {
+			const char *name = s + 1, *name_end;
+			if (*name == '{') {
+				++name;
+				name_end = strchr(name, '}');
+				s = name_end + 1;
+			} else {
+				for (name_end = name; isalnum((unsigned char)*name_end) || *name_end == '_'; ++name_end)
+					;
+				s = name_end;
+			}
+			if (!var_name_valid(name, name_end - name)) {
+				lex_fail(lx, SCRIPT_ERROR, "bad substitution");
+				free(lit);
+				word_free(w);
+				return NULL;
+			}
+			FLUSH_LIT();
+			add_part(&tail, P_VAR, dq)->var = var_lookup(name, name_end - name);
+		} else if (*s == '$' && s[1] == '?') {
+			FLUSH_LIT();
+			add_part(&tail, P_STATUS, dq);
+			s += 2;
+		} else {
+			lit[n++] = *s++;
+		}
+	}
+	FLUSH_LIT();
+#undef FLUSH_LIT
+	free(lit);
+	return w;
+}
+
+static struct word *next_word(struct lexer *lx)
+{
+	struct token *t = lex_next(lx);
+	if (t->type != T_WORD) {
+		lex_fail(lx, t->type == T_EOF ? SCRIPT_INCOMPLETE : SCRIPT_ERROR, "expected a word");
+		return NULL;
+	}
+	return compile_word(lx, t->start, t->len);
+}
+
+// ============================ parser ============================
+
+static struct script_node *parse_list(struct lexer *lx, const char *const *stop);
+
+static bool at_stop(struct lexer *lx, const char *const *stop)
+{
+	struct token *t = lex_peek(lx);
+	for (; stop && *stop; ++stop)
+		if (is_keyword(t, *stop))
+			return true;
+	return false;
+}
+
+static bool expect_keyword(struct lexer *lx, const char *kw)
+{
+	struct token *t = lex_next(lx);
+	if (is_keyword(t, kw))
+		return true;
+	if (t->type == T_EOF)
+		lex_fail(lx, SCRIPT_INCOMPLETE, kw);
+	else
+		lex_fail(lx, SCRIPT_ERROR, "unexpected token");
+	return false;
+}
+
+static void skip_separators(struct lexer *lx)
+{
+	while (lex_peek(lx)->type == T_NEWLINE || lex_peek(lx)->type == T_SEMI)
+		lex_next(lx);
+}
+
+// NAME=value at the start of a simple command
+static bool is_assignment(struct token *t)
+{
+	const char *eq = memchr(t->start, '=', t->len);
+	return t->type == T_WORD && eq != NULL && var_name_valid(t->start, eq - t->start);
+}
+
+static struct script_node *parse_simple(struct lexer *lx, struct script_node *node)
+{
+	struct stage *st = (struct stage *)calloc(1, sizeof(struct stage));
+	struct word **wtail = &st->words;
+	struct assign **atail = &node->assigns;
+	struct stage **stail = &node->stages;
+	while (*stail)
+		stail = &(*stail)->next;
+	*stail = st;
+
+	// assignments only count before the command name, and only in the first stage
+	bool leading = node->stages == st;
+	while (1) {
+		struct token *t = lex_peek(lx);
+		if (t->type == T_WORD) {
+			if (leading && is_assignment(t)) {
+				const char *eq = memchr(t->start, '=', t->len);
+				struct assign *as = (struct assign *)calloc(1, sizeof(struct assign));
+				as->var = var_lookup(t->start, eq - t->start);
+				as->value = compile_word(lx, eq + 1, t->len - (eq + 1 - t->start));
+				*atail = as;
+				atail = &as->next;
+				lex_next(lx);
+				if (as->value == NULL)
+					return NULL;
+				continue;
+			}
+			leading = false;
+			lex_next(lx);
+			*wtail = compile_word(lx, t->start, t->len);
+			if (*wtail == NULL)
+				return NULL;
+			wtail = &(*wtail)->next;
+		} else if (t->type == T_LESS || t->type == T_GREAT) {
+			bool in = t->type == T_LESS;
+			lex_next(lx);
+			struct word *file = next_word(lx);
+			if (file == NULL)
+				return NULL;
+			word_free(in ? st->in_file : st->out_file);
+			if (in)
+				st->in_file = file;
+			else
+				st->out_file = file;
+		} else {
+			break;
+		}
+	}
+	if (st->words == NULL && (st != node->stages || node->assigns == NULL)) {
+		lex_fail(lx, lex_peek(lx)->type == T_EOF ? SCRIPT_INCOMPLETE : SCRIPT_ERROR, "expected a command");
+		return NULL;
+	}
+	return node;
+}
+
+static struct script_node *parse_body(struct lexer *lx, const char *open, const char *const *stop)
+{
+	if (!expect_keyword(lx, open))
+		return NULL;
+	return parse_list(lx, stop);
+}
+
+static struct script_node *parse_if(struct lexer *lx)
+{
+	static const char *const then_stop[] = { "then", NULL };
+	static const char *const else_stop[] = { "elif", "else", "fi", NULL };
+	static const char *const fi_stop[] = { "fi", NULL };
+	struct script_node *node = new_node(N_IF);
+
+	if ((node->a = parse_list(lx, then_stop)) == NULL ||
+			(node->b = parse_body(lx, "then", else_stop)) == NULL) {
+		script_free(node);
+		return NULL;
+	}
+	struct token *t = lex_next(lx);
+	if (is_keyword(t, "elif")) {
+		node->c = parse_if(lx);
+		if (node->c == NULL) {
+			script_free(node);
+			return NULL;
+		}
+		return node;	// the nested if consumed the "fi"
+	}
+	if (is_keyword(t, "else")) {
+		node->c = parse_list(lx, fi_stop);
+		if (node->c == NULL || !expect_keyword(lx, "fi")) {
+			script_free(node);
+			return NULL;
+		}
+		return node;
+	}
+	if (!is_keyword(t, "fi")) {
+		lex_fail(lx, t->type == T_EOF ? SCRIPT_INCOMPLETE : SCRIPT_ERROR, "expected fi");
+		script_free(node);
+		return NULL;
+	}
+	return node;
+}
+
+static struct script_node *parse_do_done(struct lexer *lx, struct script_node *node)
+{
+	static const char *const done_stop[] = { "done", NULL };
+	skip_separators(lx);
+	if ((node->b = parse_body(lx, "do", done_stop)) == NULL || !expect_keyword(lx, "done")) {
+		script_free(node);
+		return NULL;
+	}
+	return node;
+}
+
+static struct script_node *parse_while(struct lexer *lx, enum node_type type)
+{
+	static const char *const do_stop[] = { "do", NULL };
+	struct script_node *node = new_node(type);
+	if ((node->a = parse_list(lx, do_stop)) == NULL) {
+		script_free(node);
+		return NULL;
+	}
+	return parse_do_done(lx, node);
+}
+
+static struct script_node *parse_for(struct lexer *lx)
+{
+	struct token *t = lex_next(lx);
+
+	// for (( init; cond; step ))
+	if (t->type == T_ARITH) {
+		struct script_node *node = new_node(N_FOR_ARITH);
+		char *text = strndup(t->start, t->len);
+		char *clause = text;
+		for (int i = 0; i < 3; ++i) {
+			char *semi = i < 2 ? strchr(clause, ';') : NULL;
+			if (i < 2 && semi == NULL) {
+				lex_fail(lx, SCRIPT_ERROR, "expected 'for ((init; cond; step))'");
+				break;
+			}
+			if (semi)
+				*semi = '\0';
+			const char *error = NULL;
+			if (strspn(clause, " \t") != strlen(clause))
+				node->arith[i] = arith_parse(clause, &error);
+			if (error) {
+				lex_fail(lx, SCRIPT_ERROR, error);
+				break;
+			}
+			clause = semi + 1;
+		}
+		free(text);
+		if (lx->status != SCRIPT_OK) {
+			script_free(node);
+			return NULL;
+		}
+		return parse_do_done(lx, node);
+	}
+
+	// for NAME in words
+	if (t->type != T_WORD || !var_name_valid(t->start, t->len)) {
+		lex_fail(lx, t->type == T_EOF ? SCRIPT_INCOMPLETE : SCRIPT_ERROR, "expected a variable name");
+		return NULL;
+	}
+	struct script_node *node = new_node(N_FOR);
+	node->var = var_lookup(t->start, t->len);
+	if (!expect_keyword(lx, "in")) {
+		script_free(node);
+		return NULL;
+	}
+	struct word **tail = &node->words;
+	while (lex_peek(lx)->type == T_WORD) {
+		t = lex_next(lx);
+		if ((*tail = compile_word(lx, t->start, t->len)) == NULL) {
+			script_free(node);
+			return NULL;
+		}
+		tail = &(*tail)->next;
+	}
+	return parse_do_done(lx, node);
+}
+
+static struct script_node *parse_command(struct lexer *lx)
+{
+	struct token *t = lex_peek(lx);
+	if (t->type == T_ARITH) {
+		const char *error;
+		char *text = strndup(t->start, t->len);
+		struct arith *a = arith_parse(text, &error);
+		free(text);
+		lex_next(lx);
+		if (a == NULL) {
+			lex_fail(lx, SCRIPT_ERROR, error);
+			return NULL;
+		}
+		struct script_node *node = new_node(N_ARITH);
+		node->arith[0] = a;
+		return node;
+	}
+	if (is_keyword(t, "if")) {
+		lex_next(lx);
+		return parse_if(lx);
+	}
+	if (is_keyword(t, "while") || is_keyword(t, "until")) {
+		enum node_type type = is_keyword(t, "while") ? N_WHILE : N_UNTIL;
+		lex_next(lx);
+		return parse_while(lx, type);
+	}
+	if (is_keyword(t, "for")) {
+		lex_next(lx);
+		return parse_for(lx);
+	}
+	if (t->type == T_WORD || t->type == T_LESS || t->type == T_GREAT) {
+		struct script_node *node = new_node(N_CMD);
+		if (parse_simple(lx, node) == NULL) {
+			script_free(node);
+			return NULL;
+		}
+		return node;
+	}
+	lex_fail(lx, t->type == T_EOF ? SCRIPT_INCOMPLETE : SCRIPT_ERROR, "unexpected token");
+	return NULL;
+}
+
+static struct script_node *parse_pipeline(struct lexer *lx)
+{
+	struct script_node *node = parse_command(lx);
+	while (node != NULL && lex_peek(lx)->type == T_PIPE) {
+		lex_next(lx);
+		while (lex_peek(lx)->type == T_NEWLINE)
+			lex_next(lx);
+		if (node->type != N_CMD) {
+			lex_fail(lx, SCRIPT_ERROR, "only simple commands can be piped");
+			script_free(node);
+			return NULL;
+		}
+		if (parse_simple(lx, node) == NULL) {
+			script_free(node);
+			return NULL;
+		}
+	}
+	return node;
+}
+
+static struct script_node *parse_and_or(struct lexer *lx)
+{
+	struct script_node *node = parse_pipeline(lx);
+	while (node != NULL && (lex_peek(lx)->type == T_AND || lex_peek(lx)->type == T_OR)) {
+		struct script_node *op = new_node(lex_next(lx)->type == T_AND ? N_AND : N_OR);
+		while (lex_peek(lx)->type == T_NEWLINE)
+			lex_next(lx);
+		op->a = node;
+		op->b = parse_pipeline(lx);
+		node = op;
+		if (op->b == NULL) {
+			script_free(op);
+			return NULL;
+		}
+	}
+	return node;
+}
+
+/**
+ * @brief Parse commands separated by ';' or newlines until the end of input
+ * or one of the "stop" keywords (which is left for the caller)
+ */
+static struct script_node *parse_list(struct lexer *lx, const char *const *stop)
+{
+	struct script_node *head = NULL, **tail = &head;
+	while (1) {
+		skip_separators(lx);
+		if (lex_peek(lx)->type == T_EOF || at_stop(lx, stop))
+			break;
+		struct script_node *cmd = parse_and_or(lx);
+		if (cmd == NULL) {
+			script_free(head);
+			return NULL;
+		}
+		struct script_node *item = new_node(N_LIST);
+		item->a = cmd;
+		*tail = item;
+		tail = &item->b;
+
+		enum tok_type next = lex_peek(lx)->type;
+		if (next != T_SEMI && next != T_NEWLINE && next != T_EOF && !at_stop(lx, stop)) {
+			lex_fail(lx, SCRIPT_ERROR, "unexpected token");
+			script_free(head);
+			return NULL;
+		}
+	}
+	if (stop && lex_peek(lx)->type == T_EOF) {
+		lex_fail(lx, SCRIPT_INCOMPLETE, stop[0]);
+		script_free(head);
+		return NULL;
+	}
+	if (head == NULL && stop) {
+		lex_fail(lx, SCRIPT_ERROR, "empty command list");
+		return NULL;
+	}
+	return head ? head : new_node(N_LIST);
+}
+
+/**
+ * @brief Parse a complete piece of input into a tree that script_exec() can run
+ *
+ * @param text Input text, possibly several lines
+ * @param status SCRIPT_INCOMPLETE when text ends inside a construct
+ * @param error Set to a message on SCRIPT_ERROR
+ * @return struct script_node*
+ * Return the tree on SCRIPT_OK, NULL otherwise
+ */
+struct script_node *script_parse(const char *text, enum script_status *status, const char **error)
+{
+	struct lexer lx = { .p = text, .status = SCRIPT_OK };
+	struct script_node *node = parse_list(&lx, NULL);
+	*status = lx.status;
+	*error = lx.error;
+	if (lx.status != SCRIPT_OK) {
+		script_free(node);
+		return NULL;
+	}
+	return node;
+}
+
+// ============================ expansion ============================
+
+struct strbuf {
+	char *s;
+	size_t len, cap;
+};
+
+struct strvec {
+	char **v;
+	int n, cap;
+};
+
+static void sb_append(struct strbuf *sb, const char *s, size_t n)
+{
+	if (sb->len + n + 1 > sb->cap) {
+		sb->cap = (sb->len + n + 1) * 2;
+		sb->s = (char *)realloc(sb->s, sb->cap);
+	}
+	memcpy(sb->s + sb->len, s, n);
+	sb->len += n;
+	sb->s[sb->len] = '\0';
+}
+
+static void sv_push(struct strvec *sv, char *s)
+{
+	if (sv->n + 2 > sv->cap) {
+		sv->cap = sv->cap ? sv->cap * 2 : 8;
+		sv->v = (char **)realloc(sv->v, sv->cap * sizeof(char *));
+	}
+	sv->v[sv->n++] = s;
+	sv->v[sv->n] = NULL;
+}
+
+static void sv_free(struct strvec *sv)
+{
+	for (int i = 0; i < sv->n; ++i)
+		free(sv->v[i]);
+	free(sv->v);
+}
+
+static void push_field(struct strvec *sv, struct strbuf *sb)
+{
+	sv_push(sv, strndup(sb->s ? sb->s : "", sb->len));
+	sb->len = 0;
+}
+
+/**
+ * @brief Expand a word into fields; unquoted expansions are split on blanks
+ *
+ * @param w Compiled word
+ * @param out Fields are appended here
+ * @param split Whether to split unquoted expansions into several fields
+ * @return bool
+ * Return false on an arithmetic error
+ */
+static bool expand_word(struct word *w, struct strvec *out, bool split)
+{
+	struct strbuf sb = { 0 };
+	bool have = w->quoted, ok = true;
+	char num[24];
+
+	for (struct word_part *p = w->parts; p && ok; p = p->next) {
+		const char *value;
+		switch (p->type) {
+		case P_LIT:
+			sb_append(&sb, p->lit, strlen(p->lit));
+			have = true;
+			continue;
+		case P_VAR:
+			value = var_get(p->var);
+			break;
+		case P_STATUS:
+			snprintf(num, sizeof(num), "%d", last_status);
+			value = num;
+			break;
+		case P_ARITH:
+		default:
+			snprintf(num, sizeof(num), "%lld", arith_eval(p->arith, &ok));
+			value = num;
+			break;
+		}
+		if (p->quoted || !split) {
+			sb_append(&sb, value, strlen(value));
+			have = true;
+			continue;
+		}
+		for (const char *c = value; *c; ++c) {
+			if (isspace((unsigned char)*c)) {
+				if (have)
+					push_field(out, &sb);
+				have = false;
+			} else {
+				sb_append(&sb, c, 1);
+				have = true;
+			}
+		}
+	}
+	if (have && ok)
+		push_field(out, &sb);
+	free(sb.s);
+	return ok;
+}
+
+// expand to exactly one string (assignments, redirection targets)
+static char *expand_single(struct word *w)
+{
+	struct strvec sv = { 0 };
+	if (!expand_word(w, &sv, false)) {
+		sv_free(&sv);
+		return NULL;
+	}
+	char *s = sv.n ? sv.v[0] : strdup("");
+	free(sv.v);
+	return s;
+}
+
+// ============================ execution ============================
+
+// pending "break N" / "continue N"
+static int loop_depth, break_levels, continue_levels;
+
+static int exec_node(struct script_node *node);
+
+static void free_expanded_cmd(struct cmd *cmd)
+{
+	while (cmd->head) {
+		struct cmd_node *temp = cmd->head;
+		cmd->head = temp->next;
+		for (int i = 0; temp->args[i]; ++i)
+			free(temp->args[i]);
+		free(temp->args);
+		free(temp->in_file);
+		free(temp->out_file);
+		free(temp);
+	}
+	affinity_free(cmd->sched);
+	free(cmd);
+}
+
+static void shift_args(struct cmd_node *node, int n)
+{
+	for (int i = 0; i < n; ++i)
+		free(node->args[i]);
+	memmove(node->args, node->args + n, (node->length - n + 1) * sizeof(char *));
+	node->length -= n;
+}
+
+// break/continue are handled here since they act on the executor's loops
+static bool loop_control(char **args)
+{
+	bool is_break = strcmp(args[0], "break") == 0;
+	if (!is_break && strcmp(args[0], "continue") != 0)
+		return false;
+	int levels = args[1] ? atoi(args[1]) : 1;
+	if (loop_depth == 0) {
+		fprintf(stderr, "psh: %s: only meaningful in a loop\n", args[0]);
+		last_status = 1;
+		return true;
+	}
+	if (levels < 1)
+		levels = 1;
+	if (levels > loop_depth)
+		levels = loop_depth;
+	if (is_break)
+		break_levels = levels;
+	else
+		continue_levels = levels;
+	last_status = 0;
+	return true;
+}
+
+static int exec_cmd(struct script_node *node)
+{
+	for (struct assign *as = node->assigns; as; as = as->next) {
+		char *value = expand_single(as->value);
+		if (value == NULL) {
+			last_status = 1;
+			return 1;
+		}
+		var_set(as->var, value);
+		free(value);
+	}
+	if (node->stages->words == NULL) {
+		last_status = 0;
+		return 1;
+	}
+
+	struct cmd *cmd = (struct cmd *)calloc(1, sizeof(struct cmd));
+	struct cmd_node **tail = &cmd->head;
+	bool ok = true;
+	for (struct stage *st = node->stages; st && ok; st = st->next) {
+		struct strvec args = { 0 };
+		for (struct word *w = st->words; w && ok; w = w->next)
+			ok = expand_word(w, &args, true);
+		if (args.v == NULL)
+			args.v = (char **)calloc(1, sizeof(char *));
+		struct cmd_node *temp = new_cmd_node(0);
+		free(temp->args);
+		temp->args = args.v;
+		temp->length = args.n;
+		if (st->in_file && (temp->in_file = expand_single(st->in_file)) == NULL)
+			ok = false;
+		if (st->out_file && (temp->out_file = expand_single(st->out_file)) == NULL)
+			ok = false;
+		*tail = temp;
+		tail = &temp->next;
+		++cmd->pipe_num;
+	}
+
+	int status = 1;
+	if (!ok) {
+		last_status = 1;
+	} else if (cmd->head->next == NULL && cmd->head->args[0] && loop_control(cmd->head->args)) {
+		// nothing to run
+	} else {
+		// prefixes, in any order: "time", "timeout N" and placement words ("@cpus=2-5 nice=-5")
+		struct cmd_node *head = cmd->head;
+		bool in_block = false;
+		while (head->args[0]) {
+			int placed;
+			if (strcmp(head->args[0], "time") == 0) {
+				// report resource usage once the command finishes
+				cmd->timed = true;
+				shift_args(head, 1);
+			} else if (strcmp(head->args[0], "timeout") == 0 && head->args[1] && head->args[2]) {
+				// kill the whole pipeline after N seconds
+				cmd->timeout = parse_duration(head->args[1]);
+				if (cmd->timeout < 0) {
+					fprintf(stderr, "psh: timeout: invalid duration '%s'\n", head->args[1]);
+					free_expanded_cmd(cmd);
+					last_status = 125;
+					return 1;
+				}
+				shift_args(head, 2);
+			} else if ((placed = affinity_parse(head->args[0], in_block, &cmd->sched)) != 0) {
+				if (placed == -1) {
+					fprintf(stderr, "psh: invalid placement '%s'\n", head->args[0]);
+					free_expanded_cmd(cmd);
+					last_status = 125;
+					return 1;
+				}
+				in_block = true;
+				shift_args(head, 1);
+			} else {
+				break;
+			}
+		}
+		status = run_cmd(cmd);
+		// every child has been reaped, so a long loop can drain the trace buffer here
+		trace_checkpoint();
+	}
+	free_expanded_cmd(cmd);
+	return status;
+}
+
+// runs a loop body, returns false when the loop has to stop
+static bool exec_body(struct script_node *body, int *status)
+{
+	*status = exec_node(body);
+	if (*status == 0)
+		return false;
+	if (break_levels > 0) {
+		--break_levels;
+		return false;
+	}
+	if (continue_levels > 0) {
+		// "continue 2" ends this loop and continues the enclosing one
+		if (--continue_levels > 0)
+			return false;
+	}
+	return true;
+}
+
+static int exec_loop(struct script_node *node)
+{
+	int status = 1, body_status = 0;
+	bool ok = true;
+	struct strvec items = { 0 };
+
+	if (node->type == N_FOR) {
+		for (struct word *w = node->words; w && ok; w = w->next)
+			ok = expand_word(w, &items, true);
+	} else if (node->type == N_FOR_ARITH && node->arith[0]) {
+		arith_eval(node->arith[0], &ok);
+	}
+	if (!ok) {
+		sv_free(&items);
+		last_status = 1;
+		return 1;
+	}
+
+	++loop_depth;
+	for (int i = 0; ; ++i) {
+		// Ctrl-C: in-process iterations are cheap, so only poll every so often
+		if (((i & 1023) == 0 || last_status >= 128) && supervise_interrupted()) {
+			break_levels = loop_depth;
+			last_status = 130;
+			ok = false;
+			break;
+		}
+		if (node->type == N_FOR) {
+			if (i >= items.n)
+				break;
+			var_set(node->var, items.v[i]);
+		} else if (node->type == N_FOR_ARITH) {
+			if (i > 0 && node->arith[2])
+				arith_eval(node->arith[2], &ok);
+			if (ok && node->arith[1] && arith_eval(node->arith[1], &ok) == 0)
+				break;
+			if (!ok)
+				break;
+		} else {
+			status = exec_node(node->a);
+			if (status == 0 || break_levels > 0 || continue_levels > 0)
+				break;
+			if ((last_status == 0) != (node->type == N_WHILE))
+				break;
+		}
+		if (!exec_body(node->b, &status))
+			break;
+		body_status = last_status;
+	}
+	--loop_depth;
+	sv_free(&items);
+	if (ok)
+		last_status = body_status;
+	else if (last_status != 130)
+		last_status = 1;
+	return status;
+}
+
+static int exec_node(struct script_node *node)
+{
+	int status = 1;
+	bool ok = true;
+
+	switch (node->type) {
+	case N_CMD:
+		return exec_cmd(node);
+	case N_ARITH:
+		last_status = arith_eval(node->arith[0], &ok) == 0 || !ok;
+		return 1;
+	case N_LIST:
+		for (; node && node->a; node = node->b) {
+			status = exec_node(node->a);
+			if (status == 0 || break_levels > 0 || continue_levels > 0)
+				break;
+		}
+		return status;
+	case N_AND:
+	case N_OR:
+		status = exec_node(node->a);
+		if (status == 0 || break_levels > 0 || continue_levels > 0)
+			return status;
+		if ((last_status == 0) == (node->type == N_AND))
+			status = exec_node(node->b);
+		return status;
+	case N_IF:
+		status = exec_node(node->a);
+		if (status == 0 || break_levels > 0 || continue_levels > 0)
+			return status;
+		if (last_status == 0)
+			return exec_node(node->b);
+		if (node->c)
+			return exec_node(node->c);
+		last_status = 0;
+		return status;
+	default:
+		return exec_loop(node);
+	}
+}
+
+/**
+ * @brief Run a parsed script
+ *
+ * @param node Tree from script_parse()
+ * @return int
+ * Return execution status, 0 when the shell should exit
+ */
+int script_exec(struct script_node *node)
+{
+	int status = exec_node(node);
+	break_levels = continue_levels = 0;
+	return status;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -5,9 +6,19 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <signal.h>
 #include <fcntl.h>
 #include "../include/command.h"
+#include "../include/shell.h"
+#include "../include/script.h"
 #include "../include/builtin.h"
+#include "../include/timing.h"
+#include "../include/trace.h"
+#include "../include/supervise.h"
+#include "../include/affinity.h"
+
+// exit status of the last command, "$?"
+int last_status = 0;
 
 // ======================= requirement 2.3 =======================
 /**
@@ -26,6 +37,7 @@ int redirection(struct cmd_node *cmd){
 			return -1;
 		}
 		dup2(in, 0);
+		close(in);
 	}
 	if (cmd->out_file != NULL) {
 		int out = open(cmd->out_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
@@ -33,6 +45,7 @@ int redirection(struct cmd_node *cmd){
 			return -1;
 		}
 		dup2(out, 1);
+		close(out);
 	}
 	if (cmd->in != 0) {
 		dup2(cmd->in, 0);
@@ -47,43 +60,76 @@ int redirection(struct cmd_node *cmd){
 // ======================= requirement 2.2 =======================
 /**
  * @brief 
- * Execute external command
- * The external command is mainly divided into the following two steps:
+ * Create the child process of a cmd_node without waiting for it
  * 1. Call "fork()" to create child process
  * 2. Call "execvp()" to execute the corresponding executable file
+ * Built-in commands (e.g. a pipeline stage such as "record | grep x") skip step 2
+ * and run directly in the forked child.
  * @param p cmd_node structure
- * @return int 
- * Return execution status
+ * @param pgid Process group to join, 0 to lead a new one
+ * @param sched CPU/scheduler/cgroup placement applied before exec, may be NULL
+ * @return pid_t 
+ * Return the child's pid, or -1 if fork failed
  */
-int spawn_proc(struct cmd_node *p)
+static pid_t start_proc(struct cmd_node *p, pid_t pgid, const struct sched_spec *sched)
 {
     pid_t pid;
-    int status;
 
+	// don't let the child inherit (and flush a second copy of) pending output
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &p->start);
+	uint64_t t = trace_now();
     pid = fork();
-    if (pid == -1) {
-        return -1;
-    } else if (pid == 0) {
+    if (pid == 0) {
         // Child process
+		supervise_child(pgid);
+		if (affinity_apply(sched) == -1)
+			_exit(126);
+		t = trace_now();
 		int err = redirection(p);
+		trace_span("redirection", p->in_file || p->out_file ? "file" : "pipe", t);
 		if (err == -1) {
-			return -1;
+			perror(p->in_file && access(p->in_file, R_OK) ? p->in_file : p->out_file);
+			_exit(1);
 		}
+		const struct builtin *builtin = searchBuiltInCommand(p);
+		if (builtin != NULL) {
+			// no exec to drop the other pipe ends, and holding them would hide EOF/EPIPE
+			close_range(3, ~0U, 0);
+			t = trace_now();
+			int bstatus;
+			execBuiltInCommand(builtin, p, &bstatus);
+			fflush(stdout);
+			trace_span("builtin", p->args[0], t);
+			_exit(bstatus);
+		}
+		trace_instant("exec", p->args[0]);
         execvp(p->args[0], p->args);
         // If execvp returns, it must have failed
-        return -1;
-    } else {
-        // Parent process
-        do {
-            waitpid(pid, &status, WUNTRACED);
-        } while (!WIFEXITED(status) && !WIFSIGNALED(status) && !WIFSTOPPED(status));
-    }
-
-	if (WIFSTOPPED(status) || WIFSIGNALED(status)) {
 		perror(p->args[0]);
-	}
+        _exit(127);
+    }
+	trace_span("fork", p->args[0], t);
+	p->pid = pid;
+	if (pid > 0)
+		supervise_adopt(pid, pgid);
+	return pid;
+}
 
-    return WIFEXITED(status);
+/**
+ * @brief 
+ * Execute external command
+ * Call "start_proc()" and wait for the child to exit
+ * @param p cmd_node structure
+ * @return int 
+ * Return execution status
+ */
+int spawn_proc(struct cmd_node *p)
+{
+	supervise_prepare();
+	if (start_proc(p, 0, NULL) == -1)
+		return -1;
+	return supervise_wait(p, 0);
 }
 // ===============================================================
 
@@ -92,7 +138,9 @@ int spawn_proc(struct cmd_node *p)
 /**
  * @brief 
  * Use "pipe()" to create a communication bridge between processes
- * Call "spawn_proc()" in order according to the number of cmd_node
+ * Start every cmd_node in order, then wait for all of them so that
+ * stages run concurrently and a full pipe never blocks a writer forever.
+ * All stages share one process group led by the first stage.
  * @param cmd Command structure  
  * @return int
  * Return execution status 
@@ -100,83 +148,181 @@ int spawn_proc(struct cmd_node *p)
 int fork_cmd_node(struct cmd *cmd)
 {
 	int pipefd[2];
-	int status = 0;
+	int status = 1;
 	int in = 0;
+	pid_t pgid = 0;
 	struct cmd_node *temp = cmd->head;
+	supervise_prepare();
 	while (temp != NULL) {
 		temp->in = in;
 		if (temp->next != NULL) {
-			pipe(pipefd);
+			// close-on-exec so no stage keeps a stray end of another stage's pipe
+			pipe2(pipefd, O_CLOEXEC);
 			temp->out = pipefd[1];
 		} else {
 			temp->out = 1;
 		}
-		status = spawn_proc(temp);
-		if (status != 1) {
+		pid_t pid = start_proc(temp, pgid, cmd->sched);
+		if (in != 0)
+			close(in);
+		if (temp->next != NULL)
+			close(pipefd[1]);
+		if (pid == -1) {
+			if (temp->next != NULL)
+				close(pipefd[0]);
+			status = -1;
 			break;
 		}
-		close(pipefd[1]);
+		if (pgid == 0)
+			pgid = pid;
 		in = pipefd[0];
 		temp = temp->next;
 	}
 
-	return status;
+	if (cmd->head->pid <= 0)
+		return status;
+	int ok = supervise_wait(cmd->head, cmd->timeout);
+	return status == -1 ? status : ok;
 }
 // ===============================================================
 
 
-void shell()
+/**
+ * @brief 
+ * Run one parsed command line: a built-in in the shell itself,
+ * an external command, or a pipeline
+ * @param cmd Command structure
+ * @return int 
+ * Return execution status, 0 when the shell should exit
+ */
+int run_cmd(struct cmd *cmd)
 {
-	while (1) {
-		printf(">>> $ ");
-		char *buffer = read_line();
-		if (buffer == NULL)
-			continue;
+	int status = -1;
+	// only a single command
+	struct cmd_node *temp = cmd->head;
+	struct time_mark begin, end;
 
-		struct cmd *cmd = split_line(buffer);
-		
-		int status = -1;
-		// only a single command
-		struct cmd_node *temp = cmd->head;
-		
-		if(temp->next == NULL){
-			status = searchBuiltInCommand(temp);
-			if (status != -1){
-				int in = dup(STDIN_FILENO), out = dup(STDOUT_FILENO);
-				if( (in == -1) | (out == -1) )
-					perror("dup");
-				redirection(temp);
-				status = execBuiltInCommand(status,temp);
-
-				// recover shell stdin and stdout
-				if (temp->in_file)  dup2(in, 0);
-				if (temp->out_file){
-					dup2(out, 1);
-				}
-				close(in);
-				close(out);
-			}
-			else{
-				//external command
-				status = spawn_proc(cmd->head);
+	if (temp->args[0] == NULL) {
+		// nothing to run, e.g. a bare "time"
+		return 1;
+	}
+	for (struct cmd_node *stage = temp->next; stage != NULL; stage = stage->next) {
+		if (stage->args[0] == NULL) {
+			fprintf(stderr, "psh: empty command in pipeline\n");
+			last_status = 2;
+			return 1;
+		}
+	}
+	// a time limit needs a child to kill and a placement needs a child to place,
+	// so both always take the pipeline path
+	bool forked = temp->next != NULL || cmd->timeout > 0 || cmd->sched != NULL;
+	// built-ins that change the shell itself would have no effect in a child
+	for (struct cmd_node *stage = forked ? temp : NULL; stage != NULL; stage = stage->next) {
+		const struct builtin *builtin = searchBuiltInCommand(stage);
+		if (builtin && !(builtin->flags & BUILTIN_PIPELINE)) {
+			fprintf(stderr, "psh: %s: cannot run %s\n", stage->args[0],
+					temp->next ? "in a pipeline" : "with a timeout or CPU placement");
+			last_status = 2;
+			return 1;
+		}
+	}
+
+	if (cmd->timed)
+		time_mark(&begin);
+	if(!forked){
+		const struct builtin *builtin = searchBuiltInCommand(temp);
+		if (builtin != NULL && !(builtin->flags & BUILTIN_FORK)){
+			int in = dup(STDIN_FILENO), out = dup(STDOUT_FILENO);
+			if( (in == -1) | (out == -1) )
+				perror("dup");
+			// keep buffered shell output out of the redirected file and vice versa
+			fflush(stdout);
+			uint64_t t = trace_now();
+			redirection(temp);
+			trace_span("redirection", temp->in_file || temp->out_file ? "file" : "none", t);
+			t = trace_now();
+			temp->pid = 0;
+			int bstatus;
+			status = execBuiltInCommand(builtin,temp,&bstatus);
+			fflush(stdout);
+			trace_span("builtin", temp->args[0], t);
+			last_status = bstatus;
+
+			// recover shell stdin and stdout
+			if (temp->in_file)  dup2(in, 0);
+			if (temp->out_file){
+				dup2(out, 1);
 			}
+			close(in);
+			close(out);
 		}
-		// There are multiple commands ( | )
 		else{
-			status = fork_cmd_node(cmd);
+			//external command
+			status = spawn_proc(cmd->head);
+		}
+	}
+	// There are multiple commands ( | )
+	else{
+		status = fork_cmd_node(cmd);
+	}
+	if (status == -1)
+		last_status = 1;
+	if (cmd->timed) {
+		time_mark(&end);
+		time_report(cmd, &begin, &end);
+	}
+	return status;
+}
+
+void shell()
+{
+	// input collected so far for a construct that spans lines (while ... done)
+	char *text = NULL;
+	size_t text_len = 0;
+
+	while (1) {
+		bool eof;
+		char *buffer = read_line(text ? "> " : ">>> $ ", &eof);
+		if (buffer == NULL) {
+			if (!eof)
+				continue;
+			if (text)
+				fprintf(stderr, "psh: syntax error: unexpected end of file\n");
+			break;
 		}
-		// free space
-		while (cmd->head) {
-			
-			struct cmd_node *temp = cmd->head;
-      		cmd->head = cmd->head->next;
-			free(temp->args);
-   	    	free(temp);
-   		}
-		free(cmd);
+
+		size_t len = strlen(buffer);
+		text = (char *)realloc(text, text_len + len + 2);
+		memcpy(text + text_len, buffer, len);
+		text_len += len;
+		text[text_len++] = '\n';
+		text[text_len] = '\0';
 		free(buffer);
-		
+
+		enum script_status st;
+		const char *error;
+		uint64_t t_cmd = trace_now();
+		struct script_node *script = script_parse(text, &st, &error);
+		trace_span("parse", text, t_cmd);
+		if (st == SCRIPT_INCOMPLETE)
+			continue;
+
+		int status = 1;
+		if (st == SCRIPT_ERROR) {
+			fprintf(stderr, "psh: syntax error: %s\n", error);
+			last_status = 2;
+		} else {
+			status = script_exec(script);
+			script_free(script);
+		}
+		trace_span("command", text, t_cmd);
+		trace_checkpoint();
+		free(text);
+		text = NULL;
+		text_len = 0;
+
 		if (status == 0)
 			break;
 	}
+	free(text);
 }
@@ -0,0 +1,349 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "../include/supervise.h"
+#include "../include/shell.h"
+#include "../include/trace.h"
+
+/*
+ * Child supervision. The shell keeps SIGCHLD, SIGINT and SIGTSTP blocked and
+ * receives them through a signalfd; every running child is watched through a
+ * pidfd. Both live in one epoll set, so a wait can also honour a deadline
+ * ("timeout N cmd") and forward Ctrl-C / Ctrl-Z to the foreground process group
+ * instead of blocking in waitpid(). There is no job control: a pipeline that
+ * Ctrl-Z stops is continued again, since nothing could ever resume it later.
+ */
+
+#define NOT_REAPED -1
+#define MAX_EVENTS 16
+
+static int epfd = -1, sigfd = -1;
+static sigset_t shell_mask, orig_mask;
+static bool interactive;
+static pid_t shell_pgid;
+static bool sigint_seen;
+static bool timeout_fired;	// the running pipeline is being killed by its timeout
+
+static int sys_pidfd_open(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return syscall(SYS_pidfd_open, pid, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Block the supervised signals, create the signalfd and the epoll set
+ */
+void supervise_init(void)
+{
+	sigemptyset(&shell_mask);
+	sigaddset(&shell_mask, SIGCHLD);
+	sigaddset(&shell_mask, SIGINT);
+	sigaddset(&shell_mask, SIGTSTP);
+	sigprocmask(SIG_BLOCK, &shell_mask, &orig_mask);
+
+	sigfd = signalfd(-1, &shell_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (sigfd == -1 || epfd == -1) {
+		perror("psh: supervise");
+		exit(1);
+	}
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+	epoll_ctl(epfd, EPOLL_CTL_ADD, sigfd, &ev);
+
+	// with a controlling terminal, each command gets the terminal while it runs
+	shell_pgid = getpgrp();
+	interactive = isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == shell_pgid;
+	if (interactive) {
+		signal(SIGTTOU, SIG_IGN);
+		signal(SIGTTIN, SIG_IGN);
+	}
+}
+
+/**
+ * @brief Forget signals that arrived while no command was running (e.g. Ctrl-C at the prompt)
+ */
+void supervise_prepare(void)
+{
+	struct signalfd_siginfo si;
+	while (read(sigfd, &si, sizeof(si)) == sizeof(si))
+		;
+	sigint_seen = false;
+}
+
+/**
+ * @brief Give a child the signal mask and dispositions the shell was started with
+ */
+void supervise_child_signals(void)
+{
+	if (interactive) {
+		signal(SIGTTOU, SIG_DFL);
+		signal(SIGTTIN, SIG_DFL);
+	}
+	sigprocmask(SIG_SETMASK, &orig_mask, NULL);
+}
+
+/**
+ * @brief Called in a child right after fork(): join the pipeline's process
+ * group (pgid 0 starts a new one) and take the terminal
+ */
+void supervise_child(pid_t pgid)
+{
+	setpgid(0, pgid);
+	if (interactive && pgid == 0)
+		tcsetpgrp(STDIN_FILENO, getpid());
+	supervise_child_signals();
+}
+
+/**
+ * @brief Parent side of supervise_child(), done in both processes so neither order races
+ */
+void supervise_adopt(pid_t pid, pid_t pgid)
+{
+	setpgid(pid, pgid ? pgid : pid);
+	if (interactive && pgid == 0)
+		tcsetpgrp(STDIN_FILENO, pid);
+}
+
+/**
+ * @brief Report and clear whether Ctrl-C hit the shell or killed its last command,
+ * so in-process loops can stop
+ */
+bool supervise_interrupted(void)
+{
+	static const struct timespec zero = { 0, 0 };
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	bool hit = sigint_seen || sigtimedwait(&set, NULL, &zero) == SIGINT;
+	sigint_seen = false;
+	return hit;
+}
+
+/**
+ * @brief Parse "10", "1.5", "500ms", "2m" or "1h" into seconds, -1 if malformed
+ */
+double parse_duration(const char *s)
+{
+	char *end;
+	double v = strtod(s, &end);
+	if (end == s || v < 0)
+		return -1;
+	if (strcmp(end, "") == 0 || strcmp(end, "s") == 0)
+		return v;
+	if (strcmp(end, "ms") == 0)
+		return v / 1000;
+	if (strcmp(end, "m") == 0)
+		return v * 60;
+	if (strcmp(end, "h") == 0)
+		return v * 3600;
+	return -1;
+}
+
+static void reaped(struct cmd_node *temp, int status, struct rusage *ru)
+{
+	clock_gettime(CLOCK_MONOTONIC, &temp->end);
+	temp->status = status;
+	temp->ru = *ru;
+	if (trace_enabled) {
+		uint64_t end = trace_now();
+		uint64_t start = end - ((temp->end.tv_sec - temp->start.tv_sec) * 1000000000ull
+				+ temp->end.tv_nsec - temp->start.tv_nsec);
+		trace_span_on(temp->pid, "stage", temp->args[0], start, end);
+	}
+	// the pipeline's status is the status of its last stage
+	if (temp->next == NULL)
+		last_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+	if (WIFSIGNALED(status)) {
+		if (WTERMSIG(status) == SIGINT)
+			sigint_seen = true;
+		// the timeout message covers the stages it killed
+		else if (timeout_fired && (WTERMSIG(status) == SIGTERM || WTERMSIG(status) == SIGKILL))
+			;
+		// a writer whose reader went away (e.g. "| head") is not worth reporting
+		else if (WTERMSIG(status) != SIGPIPE || temp->next == NULL)
+			fprintf(stderr, "%s: %s\n", temp->args[0], strsignal(WTERMSIG(status)));
+	}
+}
+
+// returns 1 if the child was reaped, 0 if it is still running, 2 if it stopped
+static int try_reap(struct cmd_node *temp, int *pidfd)
+{
+	int status;
+	struct rusage ru;
+	pid_t r;
+	while ((r = wait4(temp->pid, &status, WNOHANG | WUNTRACED, &ru)) == -1 && errno == EINTR)
+		;
+	if (r == 0)
+		return 0;
+	if (r == -1) {
+		// its status is lost (someone else reaped it): nothing left to wait
+		// for, but don't pass it off as a success
+		fprintf(stderr, "psh: %s: %s\n", temp->args[0], strerror(errno));
+		status = W_EXITCODE(1, 0);
+		memset(&ru, 0, sizeof(ru));
+	} else if (WIFSTOPPED(status)) {
+		return 2;
+	}
+	reaped(temp, status, &ru);
+	if (*pidfd != -1) {
+		close(*pidfd);
+		*pidfd = -1;
+	}
+	return 1;
+}
+
+// apply the outcome of try_reap() for node k to the running/stopped counts
+static void update(int k, struct cmd_node **node, int *pidfd, int *state, int *live, int *stopped)
+{
+	if (state[k] == 1)
+		return;
+	int r = try_reap(node[k], &pidfd[k]);
+	if (r == 1) {
+		*stopped -= state[k] == 2;
+		state[k] = 1;
+		--*live;
+	} else if (r == 2 && state[k] != 2) {
+		state[k] = 2;
+		++*stopped;
+	}
+}
+
+/**
+ * @brief 
+ * Wait for every started process of the list beginning at "head" with
+ * epoll over their pidfds and the shell's signalfd, recording each one's
+ * status, rusage and finish time in its cmd_node.
+ * Ctrl-C and Ctrl-Z that reach the shell are forwarded to the pipeline's
+ * process group; once every stage has stopped the group gets SIGCONT and the
+ * wait goes on. When "timeout" seconds pass the group gets SIGTERM and,
+ * TIMEOUT_KILL_GRACE seconds later, SIGKILL.
+ * @param head First cmd_node to wait for, its pid is the process group
+ * @param timeout Seconds before the pipeline is killed, 0 for no limit
+ * @return int 
+ * Return execution status
+ */
+int supervise_wait(struct cmd_node *head, double timeout)
+{
+	int n = 0;
+	for (struct cmd_node *temp = head; temp != NULL; temp = temp->next)
+		++n;
+	int *pidfd = (int *)malloc(n * sizeof(int));
+	int *state = (int *)calloc(n, sizeof(int));	// 0 running, 1 reaped, 2 stopped
+	struct cmd_node **node = (struct cmd_node **)malloc(n * sizeof(struct cmd_node *));
+	int live = 0, stopped = 0, i = 0;
+	pid_t pgid = head->pid;
+	double deadline = timeout > 0 ? now_sec() + timeout : 0, kill_at = 0;
+
+	uint64_t t = trace_now();
+	timeout_fired = false;
+	for (struct cmd_node *temp = head; temp != NULL; temp = temp->next, ++i) {
+		node[i] = temp;
+		pidfd[i] = -1;
+		if (temp->pid <= 0) {
+			state[i] = 1;
+			continue;
+		}
+		temp->status = NOT_REAPED;
+		++live;
+		// without pidfd (old kernels) SIGCHLD alone drives the reaping
+		pidfd[i] = sys_pidfd_open(temp->pid);
+		if (pidfd[i] != -1) {
+			struct epoll_event ev = { .events = EPOLLIN, .data.u64 = (uint64_t)i + 1 };
+			epoll_ctl(epfd, EPOLL_CTL_ADD, pidfd[i], &ev);
+		}
+	}
+
+	while (live > 0) {
+		if (stopped == live) {
+			// nothing could resume a stopped pipeline later, so let it run on
+			fprintf(stderr, "\n[%d] %s: %s, continuing (no job control)\n", pgid, head->args[0], strsignal(SIGTSTP));
+			kill(-pgid, SIGCONT);
+			for (int k = 0; k < n; ++k)
+				if (state[k] == 2)
+					state[k] = 0;
+			stopped = 0;
+		}
+		int ms = -1;
+		double next = kill_at ? kill_at : deadline;
+		if (next) {
+			double left = next - now_sec();
+			ms = left > 0 ? (int)(left * 1000) + 1 : 0;
+		}
+		struct epoll_event evs[MAX_EVENTS];
+		int nev = epoll_wait(epfd, evs, MAX_EVENTS, ms);
+		if (nev == -1 && errno != EINTR)
+			break;
+
+		if (nev == 0 && next) {
+			if (kill_at) {
+				kill(-pgid, SIGKILL);
+				kill_at = 0;
+				deadline = 0;
+			} else {
+				timeout_fired = true;
+				kill(-pgid, SIGTERM);
+				kill(-pgid, SIGCONT);
+				kill_at = now_sec() + TIMEOUT_KILL_GRACE;
+			}
+			continue;
+		}
+
+		bool scan = false;
+		for (int e = 0; e < nev; ++e) {
+			if (evs[e].data.u64 != 0) {
+				update(evs[e].data.u64 - 1, node, pidfd, state, &live, &stopped);
+				continue;
+			}
+			struct signalfd_siginfo si;
+			while (read(sigfd, &si, sizeof(si)) == sizeof(si)) {
+				if (si.ssi_signo == SIGCHLD) {
+					scan = true;
+				} else {
+					// Ctrl-C / Ctrl-Z typed while the shell owned the terminal, or sent to the shell
+					if (si.ssi_signo == SIGINT)
+						sigint_seen = true;
+					kill(-pgid, si.ssi_signo);
+				}
+			}
+		}
+		// SIGCHLD also reports stops, which pidfds don't
+		for (int k = 0; scan && k < n; ++k)
+			update(k, node, pidfd, state, &live, &stopped);
+	}
+
+	if (timeout_fired) {
+		fprintf(stderr, "psh: timeout: %s: killed after %gs\n", head->args[0], timeout);
+		last_status = TIMEOUT_STATUS;
+	}
+	for (int k = 0; k < n; ++k)
+		if (pidfd[k] != -1)
+			close(pidfd[k]);
+	if (interactive)
+		tcsetpgrp(STDIN_FILENO, shell_pgid);
+	free(pidfd);
+	free(state);
+	free(node);
+	trace_span("wait", head->args[0], t);
+	return 1;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "../include/timing.h"
+
+/**
+ * @brief Record the current wall clock and the shell's own resource usage
+ * 
+ * @param mark Where to store the snapshot
+ */
+void time_mark(struct time_mark *mark)
+{
+	clock_gettime(CLOCK_MONOTONIC, &mark->wall);
+	getrusage(RUSAGE_SELF, &mark->self);
+}
+
+static double ts_diff(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static double tv_sec(const struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static void print_row(const char *stage, double real, double user, double sys,
+		long maxrss, long nvcsw, long nivcsw, char **args)
+{
+	fprintf(stderr, "%-6s %9.6fs %9.6fs %9.6fs %8ldKB %7ld %7ld ",
+			stage, real, user, sys, maxrss, nvcsw, nivcsw);
+	for (int i = 0; args && args[i]; ++i)
+		fprintf(stderr, "%s ", args[i]);
+	fprintf(stderr, "\n");
+}
+
+/**
+ * @brief Print wall/user/sys time, max RSS and context switches of a command
+ * Stages that were forked report the rusage collected by wait4() in spawn_proc(),
+ * a lone built-in that ran inside the shell reports the shell's own usage
+ * between begin and end, and stages that never started (a failed fork) are
+ * listed as such and left out of the total.
+ * @param cmd Command structure that has finished executing
+ * @param begin Snapshot taken before the command started
+ * @param end Snapshot taken after the command finished
+ */
+void time_report(struct cmd *cmd, const struct time_mark *begin, const struct time_mark *end)
+{
+	double user = 0, sys = 0;
+	long maxrss = 0, nvcsw = 0, nivcsw = 0;
+	char stage[16];
+	int n = 0;
+
+	fprintf(stderr, "%-6s %10s %10s %10s %10s %7s %7s %s\n",
+			"stage", "real", "user", "sys", "maxrss", "nvcsw", "nivcsw", "command");
+	for (struct cmd_node *temp = cmd->head; temp != NULL; temp = temp->next, ++n) {
+		snprintf(stage, sizeof(stage), "%d", n);
+		if (temp->pid > 0) {
+			double u = tv_sec(&temp->ru.ru_utime), s = tv_sec(&temp->ru.ru_stime);
+			print_row(stage, ts_diff(&temp->start, &temp->end), u, s,
+					temp->ru.ru_maxrss, temp->ru.ru_nvcsw, temp->ru.ru_nivcsw, temp->args);
+			user += u;
+			sys += s;
+			if (temp->ru.ru_maxrss > maxrss)
+				maxrss = temp->ru.ru_maxrss;
+			nvcsw += temp->ru.ru_nvcsw;
+			nivcsw += temp->ru.ru_nivcsw;
+		} else if (temp->pid < 0) {
+			// fork failed here or before this stage: nothing ran
+			fprintf(stderr, "%-6s %10s ", stage, "not started");
+			for (int i = 0; temp->args && temp->args[i]; ++i)
+				fprintf(stderr, "%s ", temp->args[i]);
+			fprintf(stderr, "\n");
+		} else {
+			// a lone built-in ran in-process: charge the shell's own usage to it
+			double u = tv_sec(&end->self.ru_utime) - tv_sec(&begin->self.ru_utime);
+			double s = tv_sec(&end->self.ru_stime) - tv_sec(&begin->self.ru_stime);
+			long v = end->self.ru_nvcsw - begin->self.ru_nvcsw;
+			long iv = end->self.ru_nivcsw - begin->self.ru_nivcsw;
+			print_row(stage, ts_diff(&begin->wall, &end->wall), u, s,
+					end->self.ru_maxrss, v, iv, temp->args);
+			user += u;
+			sys += s;
+			if (end->self.ru_maxrss > maxrss)
+				maxrss = end->self.ru_maxrss;
+			nvcsw += v;
+			nivcsw += iv;
+		}
+	}
+	if (n > 1)
+		print_row("total", ts_diff(&begin->wall, &end->wall), user, sys,
+				maxrss, nvcsw, nivcsw, NULL);
+}
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "../include/trace.h"
+
+struct trace_event {
+	uint64_t ts, dur;	// nanoseconds on CLOCK_MONOTONIC
+	pid_t tid;
+	char ph;			// 'X' complete event, 'i' instant event
+	char name[19];
+	char detail[96];
+};
+
+// Shared with every forked child so that redirection/exec events recorded
+// after fork() land in the same buffer as the shell's own events.
+struct trace_buffer {
+	unsigned long head;
+	unsigned long dropped;
+	struct trace_event events[TRACE_MAX_EVENTS];
+};
+
+bool trace_enabled = false;
+
+static struct trace_buffer *buf;
+static FILE *out;
+static pid_t shell_pid;
+static uint64_t epoch;
+static bool first_event;
+
+uint64_t trace_now(void)
+{
+	struct timespec ts;
+	if (!trace_enabled)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static struct trace_event *trace_alloc(void)
+{
+	unsigned long i = __atomic_fetch_add(&buf->head, 1, __ATOMIC_RELAXED);
+	if (i >= TRACE_MAX_EVENTS) {
+		__atomic_fetch_add(&buf->dropped, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	return &buf->events[i];
+}
+
+static void trace_record(char ph, pid_t tid, const char *name, const char *detail,
+		uint64_t start, uint64_t end)
+{
+	struct trace_event *e = trace_alloc();
+	if (e == NULL)
+		return;
+	e->ts = start;
+	e->dur = end - start;
+	e->tid = tid;
+	e->ph = ph;
+	strncpy(e->name, name, sizeof(e->name) - 1);
+	e->name[sizeof(e->name) - 1] = '\0';
+	strncpy(e->detail, detail ? detail : "", sizeof(e->detail) - 1);
+	e->detail[sizeof(e->detail) - 1] = '\0';
+}
+
+/**
+ * @brief Record a complete event of the calling process from "start" until now
+ * 
+ * @param name Event name shown in the trace viewer
+ * @param detail Free text stored as the event's "detail" argument, may be NULL
+ * @param start Value of trace_now() when the event began
+ */
+void trace_span(const char *name, const char *detail, uint64_t start)
+{
+	if (!trace_enabled)
+		return;
+	trace_record('X', getpid(), name, detail, start, trace_now());
+}
+
+/**
+ * @brief Record a complete event on the track of another process (e.g. a reaped child)
+ */
+void trace_span_on(pid_t tid, const char *name, const char *detail, uint64_t start, uint64_t end)
+{
+	if (!trace_enabled)
+		return;
+	trace_record('X', tid, name, detail, start, end);
+}
+
+void trace_instant(const char *name, const char *detail)
+{
+	if (!trace_enabled)
+		return;
+	uint64_t now = trace_now();
+	trace_record('i', getpid(), name, detail, now, now);
+}
+
+static void write_escaped(const char *s)
+{
+	for (; *s; ++s) {
+		if (*s == '"' || *s == '\\')
+			fprintf(out, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(out, "\\u%04x", *s);
+		else
+			fputc(*s, out);
+	}
+}
+
+static void write_separator(void)
+{
+	if (!first_event)
+		fprintf(out, ",\n");
+	first_event = false;
+}
+
+/**
+ * @brief 
+ * Write the buffered events to the trace file as Chrome trace-event JSON and
+ * empty the buffer. Must only be called by the shell while no child is running.
+ */
+void trace_flush(void)
+{
+	if (!trace_enabled)
+		return;
+	unsigned long n = buf->head < TRACE_MAX_EVENTS ? buf->head : TRACE_MAX_EVENTS;
+	for (unsigned long i = 0; i < n; ++i) {
+		struct trace_event *e = &buf->events[i];
+		write_separator();
+		fprintf(out, "{\"name\":\"");
+		write_escaped(e->name);
+		fprintf(out, "\",\"cat\":\"psh\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+				e->ph, shell_pid, e->tid, (e->ts - epoch) / 1000.0);
+		if (e->ph == 'X')
+			fprintf(out, ",\"dur\":%.3f", e->dur / 1000.0);
+		else
+			fprintf(out, ",\"s\":\"t\"");
+		fprintf(out, ",\"args\":{\"detail\":\"");
+		write_escaped(e->detail);
+		fprintf(out, "\"}}");
+	}
+	buf->head = 0;
+	fflush(out);
+}
+
+/**
+ * @brief Flush only once the buffer is three quarters full, called between commands
+ */
+void trace_checkpoint(void)
+{
+	if (trace_enabled && buf->head >= TRACE_MAX_EVENTS / 4 * 3)
+		trace_flush();
+}
+
+/**
+ * @brief Start recording into a fresh trace file
+ * 
+ * @param path Output file, overwritten
+ * @return int 
+ * Return 0 on success, -1 on error
+ */
+int trace_start(const char *path)
+{
+	trace_stop();
+	out = fopen(path, "w");
+	if (out == NULL) {
+		perror(path);
+		return -1;
+	}
+	buf = mmap(NULL, sizeof(struct trace_buffer), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		perror("mmap");
+		fclose(out);
+		out = NULL;
+		buf = NULL;
+		return -1;
+	}
+	shell_pid = getpid();
+	first_event = true;
+	trace_enabled = true;
+	epoch = trace_now();
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	write_separator();
+	fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"psh\"}}",
+			shell_pid);
+	return 0;
+}
+
+/**
+ * @brief Flush the remaining events, close the JSON document and stop recording
+ */
+void trace_stop(void)
+{
+	if (!trace_enabled || getpid() != shell_pid)
+		return;
+	trace_flush();
+	if (buf->dropped) {
+		write_separator();
+		fprintf(out, "{\"name\":\"dropped_events\",\"ph\":\"C\",\"pid\":%d,\"ts\":0,\"args\":{\"dropped\":%lu}}",
+				shell_pid, buf->dropped);
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+	munmap(buf, sizeof(struct trace_buffer));
+	out = NULL;
+	buf = NULL;
+	trace_enabled = false;
+}
+
+/**
+ * @brief Enable tracing at startup when $PSH_TRACE names an output file
+ */
+void trace_init(void)
+{
+	const char *path = getenv(TRACE_ENV);
+	if (path != NULL && path[0] != '\0')
+		trace_start(path);
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../include/vars.h"
+
+static struct var *table[VAR_TABLE_SIZE];
+
+static unsigned hash(const char *name, size_t len)
+{
+	unsigned h = 2166136261u;
+	for (size_t i = 0; i < len; ++i)
+		h = (h ^ (unsigned char)name[i]) * 16777619u;
+	return h % VAR_TABLE_SIZE;
+}
+
+/**
+ * @brief Check that name[0..len) is a valid variable name ([A-Za-z_][A-Za-z0-9_]*)
+ */
+bool var_name_valid(const char *name, size_t len)
+{
+	if (len == 0 || !(isalpha((unsigned char)name[0]) || name[0] == '_'))
+		return false;
+	for (size_t i = 1; i < len; ++i)
+		if (!(isalnum((unsigned char)name[i]) || name[i] == '_'))
+			return false;
+	return true;
+}
+
+/**
+ * @brief Find the slot of a variable, creating an unset one if needed
+ * 
+ * @param name Variable name, not necessarily NUL terminated
+ * @param len Length of the name
+ * @return struct var* 
+ * Return the variable's slot, valid for the lifetime of the shell
+ */
+struct var *var_lookup(const char *name, size_t len)
+{
+	unsigned h = hash(name, len);
+	for (struct var *v = table[h]; v != NULL; v = v->next)
+		if (strncmp(v->name, name, len) == 0 && v->name[len] == '\0')
+			return v;
+
+	struct var *v = (struct var *)calloc(1, sizeof(struct var));
+	v->name = strndup(name, len);
+	v->next = table[h];
+	table[h] = v;
+	return v;
+}
+
+/**
+ * @brief Value of a variable, falling back to the environment, "" when unset
+ */
+const char *var_get(struct var *v)
+{
+	if (v->value == NULL) {
+		if (!v->has_ival) {
+			const char *env = getenv(v->name);
+			return env ? env : "";
+		}
+		// integer assigned by arithmetic, format it on first use
+		char buf[24];
+		snprintf(buf, sizeof(buf), "%lld", v->ival);
+		v->value = strdup(buf);
+	}
+	return v->value;
+}
+
+/**
+ * @brief Integer value of a variable as used by arithmetic, 0 when unset or not a number
+ */
+long long var_get_int(struct var *v)
+{
+	if (!v->has_ival) {
+		long long n = strtoll(var_get(v), NULL, 0);
+		// only cache what really came from the shell, the environment may change
+		if (v->value == NULL)
+			return n;
+		v->ival = n;
+		v->has_ival = true;
+	}
+	return v->ival;
+}
+
+void var_set(struct var *v, const char *value)
+{
+	free(v->value);
+	v->value = strdup(value);
+	v->has_ival = false;
+}
+
+/**
+ * @brief Assign an integer; the string form is only built when someone expands it
+ */
+void var_set_int(struct var *v, long long n)
+{
+	free(v->value);
+	v->value = NULL;
+	v->ival = n;
+	v->has_ival = true;
+}
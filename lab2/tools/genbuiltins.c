@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/builtin.h"
+
+/*
+ * Build-time generator for builtin_table.h: finds a seed for builtin_hash()
+ * that sends every name in builtins.def to its own slot of a power-of-two
+ * table, so searchBuiltInCommand() is one hash and one strcmp.
+ */
+
+static const struct {
+	const char *name, *func, *flags;
+} defs[] = {
+#define BUILTIN(name, func, flags) { name, #func, #flags },
+#include "../include/builtins.def"
+#undef BUILTIN
+};
+
+#define NUM_DEFS (int)(sizeof(defs) / sizeof(defs[0]))
+
+int main(void)
+{
+	for (unsigned slots = 2; slots <= 1u << 16; slots *= 2) {
+		if (slots < 2 * NUM_DEFS)
+			continue;
+		int *slot_of = (int *)malloc(NUM_DEFS * sizeof(int));
+		char *used = (char *)malloc(slots);
+		for (uint32_t seed = 0; seed < 100000; ++seed) {
+			memset(used, 0, slots);
+			int i;
+			for (i = 0; i < NUM_DEFS; ++i) {
+				slot_of[i] = builtin_hash(defs[i].name, seed) & (slots - 1);
+				if (used[slot_of[i]])
+					break;
+				used[slot_of[i]] = 1;
+			}
+			if (i < NUM_DEFS)
+				continue;
+
+			printf("/* generated by tools/genbuiltins.c from include/builtins.def, do not edit */\n");
+			printf("#define BUILTIN_SEED %uu\n", seed);
+			printf("#define BUILTIN_SLOTS %u\n\n", slots);
+			printf("static const struct builtin builtin_table[BUILTIN_SLOTS] = {\n");
+			for (i = 0; i < NUM_DEFS; ++i)
+				printf("\t[%d] = { \"%s\", %s, %s },\n", slot_of[i], defs[i].name, defs[i].func, defs[i].flags);
+			printf("};\n\n");
+			printf("// slots in definition order\n");
+			printf("static const unsigned short builtin_order[] = {");
+			for (i = 0; i < NUM_DEFS; ++i)
+				printf("%s%d", i ? ", " : " ", slot_of[i]);
+			printf(" };\n");
+			return 0;
+		}
+		free(slot_of);
+		free(used);
+	}
+	fprintf(stderr, "genbuiltins: no collision-free seed found\n");
+	return 1;
+}
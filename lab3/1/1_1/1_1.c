@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include "../../common/counter.h"
 
 volatile int a = 0;
 pthread_spinlock_t lock;
+struct sharded_counter counter;
 
 void *thread(void *arg) {
     /*YOUR CODE HERE*/
@@ -14,11 +17,47 @@ void *thread(void *arg) {
     return NULL;
 }
 
-int main() {
+// -s / -a K: each thread counts into its own shard of counter, no lock at all
+void *sharded_thread(void *arg) {
+    int shard = (int)(long)arg;
+    for(int i=0; i<10000; i++) counter_add(&counter, shard, 1);
+    counter_flush(&counter, shard);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    long flush_every = -1;  // -1: count in a under the lock, 0: exact shards, > 0: approximate shards
+    int opt;
+    while ((opt = getopt(argc, argv, "sa:")) != -1) {
+        if (opt == 's') {
+            flush_every = 0;
+        } else if (opt == 'a' && atol(optarg) > 0) {
+            flush_every = atol(optarg);
+        } else {
+            fprintf(stderr, "usage: %s [-s | -a flush_every]\n", argv[0]);
+            return 2;
+        }
+    }
     FILE *fptr;
     fptr = fopen("1.txt", "a");
     pthread_t t1, t2;
 
+    if (flush_every >= 0) {
+        if (counter_init(&counter, 2, flush_every) != 0) {
+            perror("counter_init");
+            return 1;
+        }
+        pthread_create(&t1, NULL, sharded_thread, (void *)0L);
+        pthread_create(&t2, NULL, sharded_thread, (void *)1L);
+        pthread_join(t1, NULL);
+        pthread_join(t2, NULL);
+        a = counter_read(&counter);
+        counter_free(&counter);
+        fprintf(fptr, "%d ", a);
+        fclose(fptr);
+        return 0;
+    }
+
     pthread_spin_init(&lock, 0);
     pthread_create(&t1, NULL, thread, NULL);
     pthread_create(&t2, NULL, thread, NULL);
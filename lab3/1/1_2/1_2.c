@@ -3,14 +3,30 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../../common/counter.h"
 
 /*Note: Value of LOCK is 0 and value of UNLOCK is 1.*/
 #define LOCK 0
 #define UNLOCK 1
 
 volatile int a = 0;
-volatile int lock = UNLOCK;
 pthread_mutex_t mutex;
+struct sharded_counter counter;
+
+#ifdef LOCK_IMPL
+// built with a lock from ../../common/locks.h instead of the xchg loop (make judge LOCK=...)
+#include "../../common/locks.h"
+lock_t queue_lock;
+
+void spin_lock() {
+    lock_acquire(&queue_lock);
+}
+
+void spin_unlock() {
+    lock_release(&queue_lock);
+}
+#else
+volatile int lock = UNLOCK;
 
 void spin_lock() {
     asm volatile(
@@ -34,6 +50,7 @@ void spin_unlock() {
         : "eax", "memory"
     );
 }
+#endif
 
 
 void *thread(void *arg) {
@@ -47,12 +64,51 @@ void *thread(void *arg) {
     return NULL;
 }
 
-int main() {
+// -s / -a K: each thread counts into its own shard of counter, no lock at all
+void *sharded_thread(void *arg) {
+    int shard = (int)(long)arg;
+    for(int i=0; i<10000; i++) counter_add(&counter, shard, 1);
+    counter_flush(&counter, shard);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    long flush_every = -1;  // -1: count in a under the lock, 0: exact shards, > 0: approximate shards
+    int opt;
+    while ((opt = getopt(argc, argv, "sa:")) != -1) {
+        if (opt == 's') {
+            flush_every = 0;
+        } else if (opt == 'a' && atol(optarg) > 0) {
+            flush_every = atol(optarg);
+        } else {
+            fprintf(stderr, "usage: %s [-s | -a flush_every]\n", argv[0]);
+            return 2;
+        }
+    }
     FILE *fptr;
     fptr = fopen("1.txt", "a");
     pthread_t t1, t2;
 
+    if (flush_every >= 0) {
+        if (counter_init(&counter, 2, flush_every) != 0) {
+            perror("counter_init");
+            return 1;
+        }
+        pthread_create(&t1, NULL, sharded_thread, (void *)0L);
+        pthread_create(&t2, NULL, sharded_thread, (void *)1L);
+        pthread_join(t1, NULL);
+        pthread_join(t2, NULL);
+        a = counter_read(&counter);
+        counter_free(&counter);
+        fprintf(fptr, "%d ", a);
+        fclose(fptr);
+        return 0;
+    }
+
     pthread_mutex_init(&mutex, 0);
+#ifdef LOCK_IMPL
+    lock_init(&queue_lock);
+#endif
     pthread_create(&t1, NULL, thread, NULL);
     pthread_create(&t2, NULL, thread, NULL);
     pthread_join(t1, NULL);
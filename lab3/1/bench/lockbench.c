@@ -0,0 +1,373 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "../../common/locks.h"
+#include "../../common/counter.h"
+
+// Lock contention benchmark for the lab3/1 locks. For each lock type and
+// thread count, every thread repeatedly takes the lock, does the critical
+// work (which includes a plain increment of a shared counter, checked at the
+// end), releases it, and does the non-critical work, until the run time is
+// up. Reported per case: total acquisitions per second, per-thread
+// acquisition counts (min, max and Jain's fairness index, 1.0 = perfectly
+// even), and percentiles of the time spent waiting for the lock.
+// The counter types (atomic, sharded, approx) count without any lock for
+// comparison; for them the latency is that of one increment.
+
+#define CACHE_LINE 64
+#define MAX_THREADS 256
+#define LAT_EVERY 16            // time one acquisition in this many
+#define LAT_SAMPLES (1 << 16)   // per thread
+
+// ============================ locks ============================
+
+// pthread_spinlock_t, as in 1_1
+static void pspin_init(void *l) { pthread_spin_init(l, PTHREAD_PROCESS_PRIVATE); }
+static void pspin_lock(void *l) { pthread_spin_lock(l); }
+static void pspin_unlock(void *l) { pthread_spin_unlock(l); }
+
+static void mutex_init(void *l) { pthread_mutex_init(l, NULL); }
+static void mutex_lock(void *l) { pthread_mutex_lock(l); }
+static void mutex_unlock(void *l) { pthread_mutex_unlock(l); }
+
+// The xchg loop from 1_2: 1 is unlocked, 0 locked
+static void xchg_init(void *l) { *(volatile int *)l = 1; }
+static void xchg_lock(void *l)
+{
+    asm volatile(
+        "1:\n\t"
+            "mov $0, %%eax\n\t"
+            "xchg %%eax, %[lock]\n\t"
+            "test %%eax, %%eax\n\t"
+            "je 1b\n\t"
+        : [lock] "+m" (*(volatile int *)l)
+        :
+        : "eax", "memory"
+    );
+}
+static void xchg_unlock(void *l)
+{
+    asm volatile(
+        "mov $1, %%eax\n\t"
+        "xchg %%eax, %[lock]\n\t"
+        : [lock] "+m" (*(volatile int *)l)
+        :
+        : "eax", "memory"
+    );
+}
+
+// The queue-lock library; mcs and clh keep their per-thread node in a thread-local
+static void ttas_bench_init(void *l) { ttas_init(l); }
+static void ttas_bench_lock(void *l) { ttas_lock(l); }
+static void ttas_bench_unlock(void *l) { ttas_unlock(l); }
+
+static void ticket_bench_init(void *l) { ticket_init(l); }
+static void ticket_bench_lock(void *l) { ticket_lock(l); }
+static void ticket_bench_unlock(void *l) { ticket_unlock(l); }
+
+static _Thread_local struct mcs_node mcs_self;
+static void mcs_bench_init(void *l) { mcs_init(l); }
+static void mcs_bench_lock(void *l) { mcs_lock(l, &mcs_self); }
+static void mcs_bench_unlock(void *l) { mcs_unlock(l, &mcs_self); }
+
+static _Thread_local struct clh_handle clh_self;
+static void clh_bench_init(void *l) { clh_init(l); }
+static void clh_bench_lock(void *l) { clh_lock(l, &clh_self); }
+static void clh_bench_unlock(void *l) { clh_unlock(l, &clh_self); }
+
+// Futex lock (Drepper, "Futexes Are Tricky", mutex 2): 0 free, 1 held, 2 held with sleepers
+static long futex(atomic_int *addr, int op, int val)
+{
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+static void futex_init(void *l) { atomic_init((atomic_int *)l, 0); }
+static void futex_lock(void *l)
+{
+    atomic_int *f = l;
+    int c = 0;
+    if (atomic_compare_exchange_strong(f, &c, 1))
+        return;
+    if (c != 2)
+        c = atomic_exchange(f, 2);
+    while (c != 0) {
+        futex(f, FUTEX_WAIT_PRIVATE, 2);
+        c = atomic_exchange(f, 2);
+    }
+}
+static void futex_unlock(void *l)
+{
+    atomic_int *f = l;
+    if (atomic_fetch_sub(f, 1) != 1) {
+        atomic_store(f, 0);
+        futex(f, FUTEX_WAKE_PRIVATE, 1);
+    }
+}
+
+// ============================ counters ============================
+
+// Counter types take no lock: each iteration is one add(), and the total
+// checked at the end is read() after every thread has run finish().
+static atomic_long atomic_total;
+static struct sharded_counter sharded;
+static long approx_flush = 64;
+
+static void atomic_init_total(void *l) { (void)l; atomic_store(&atomic_total, 0); }
+static void atomic_add(int thread) { (void)thread; atomic_fetch_add_explicit(&atomic_total, 1, memory_order_relaxed); }
+static long atomic_read(void) { return atomic_load(&atomic_total); }
+
+static void sharded_init(void *l) { (void)l; counter_free(&sharded); counter_init(&sharded, MAX_THREADS, 0); }
+static void approx_init(void *l) { (void)l; counter_free(&sharded); counter_init(&sharded, MAX_THREADS, approx_flush); }
+static void sharded_add(int thread) { counter_add(&sharded, thread, 1); }
+static void sharded_finish(int thread) { counter_flush(&sharded, thread); }
+static long sharded_read(void) { return counter_read(&sharded); }
+
+static const struct lock_type {
+    const char *name;
+    void (*init)(void *l);
+    void (*lock)(void *l);
+    void (*unlock)(void *l);
+    // counter types instead of lock/unlock
+    void (*add)(int thread);
+    void (*finish)(int thread);
+    long (*read)(void);
+} lock_types[] = {
+    { "pspin", pspin_init, pspin_lock, pspin_unlock },
+    { "mutex", mutex_init, mutex_lock, mutex_unlock },
+    { "xchg", xchg_init, xchg_lock, xchg_unlock },
+    { "ttas", ttas_bench_init, ttas_bench_lock, ttas_bench_unlock },
+    { "ticket", ticket_bench_init, ticket_bench_lock, ticket_bench_unlock },
+    { "mcs", mcs_bench_init, mcs_bench_lock, mcs_bench_unlock },
+    { "clh", clh_bench_init, clh_bench_lock, clh_bench_unlock },
+    { "futex", futex_init, futex_lock, futex_unlock },
+    { "atomic", atomic_init_total, NULL, NULL, atomic_add, NULL, atomic_read },
+    { "sharded", sharded_init, NULL, NULL, sharded_add, NULL, sharded_read },
+    { "approx", approx_init, NULL, NULL, sharded_add, sharded_finish, sharded_read },
+};
+#define NUM_LOCK_TYPES ((int)(sizeof(lock_types) / sizeof(lock_types[0])))
+
+// ============================ run ============================
+
+static struct {
+    int cs_work, ncs_work;
+    double seconds;
+    int pin;
+    int verbose;
+} opt = { .cs_work = 10, .ncs_work = 50, .seconds = 0.5 };
+
+// the lock and the data it protects share a line, as they would in real code
+static struct {
+    _Alignas(CACHE_LINE) union {
+        pthread_spinlock_t pspin;
+        pthread_mutex_t mutex;
+        int xchg;
+        struct ttas_lock ttas;
+        struct ticket_lock ticket;
+        struct mcs_lock mcs;
+        struct clh_lock clh;
+        atomic_int futex;
+    } lock;
+    volatile long counter;
+} shared;
+
+struct worker {
+    _Alignas(CACHE_LINE) long acquisitions;
+    int id;
+    int samples;
+    unsigned *latency;          // ns, one per LAT_EVERY acquisitions
+    pthread_t thread;
+};
+
+static struct worker workers[MAX_THREADS];
+static const struct lock_type *current;
+static pthread_barrier_t start;
+static atomic_int stop;
+
+static unsigned long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static void work(int n)
+{
+    for (volatile int i = 0; i < n; i++)
+        ;
+}
+
+static void *run_thread(void *arg)
+{
+    struct worker *w = arg;
+    void *l = &shared.lock;
+    if (opt.pin) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->id % sysconf(_SC_NPROCESSORS_ONLN), &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    pthread_barrier_wait(&start);
+    long n = 0;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        int timed = n % LAT_EVERY == 0 && w->samples < LAT_SAMPLES;
+        unsigned long t0 = timed ? now_ns() : 0;
+        if (current->add) {
+            current->add(w->id);
+            if (timed)
+                w->latency[w->samples++] = now_ns() - t0;
+        } else {
+            current->lock(l);
+            if (timed)
+                w->latency[w->samples++] = now_ns() - t0;
+            shared.counter++;
+            work(opt.cs_work);
+            current->unlock(l);
+        }
+        n++;
+        work(opt.ncs_work);
+    }
+    if (current->finish)
+        current->finish(w->id);
+    w->acquisitions = n;
+    return NULL;
+}
+
+static int cmp_unsigned(const void *a, const void *b)
+{
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run_case(const struct lock_type *type, int threads)
+{
+    current = type;
+    shared.counter = 0;
+    type->init(&shared.lock);
+    atomic_store(&stop, 0);
+    pthread_barrier_init(&start, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        workers[i].id = i;
+        workers[i].samples = 0;
+        workers[i].acquisitions = 0;
+        pthread_create(&workers[i].thread, NULL, run_thread, &workers[i]);
+    }
+    pthread_barrier_wait(&start);
+    unsigned long begin = now_ns();
+    struct timespec ts = { (time_t)opt.seconds, (long)((opt.seconds - (time_t)opt.seconds) * 1e9) };
+    nanosleep(&ts, NULL);
+    atomic_store(&stop, 1);
+    for (int i = 0; i < threads; i++)
+        pthread_join(workers[i].thread, NULL);
+    double elapsed = (now_ns() - begin) / 1e9;
+    pthread_barrier_destroy(&start);
+
+    long total = 0, min = -1, max = 0;
+    long counted = type->read ? type->read() : shared.counter;
+    double sum_sq = 0;
+    int samples = 0;
+    for (int i = 0; i < threads; i++) {
+        long a = workers[i].acquisitions;
+        total += a;
+        sum_sq += (double)a * a;
+        min = min < 0 || a < min ? a : min;
+        max = a > max ? a : max;
+        samples += workers[i].samples;
+    }
+    unsigned *lat = malloc((samples ? samples : 1) * sizeof(unsigned));
+    for (int i = 0, k = 0; i < threads; i++) {
+        memcpy(lat + k, workers[i].latency, workers[i].samples * sizeof(unsigned));
+        k += workers[i].samples;
+    }
+    qsort(lat, samples, sizeof(unsigned), cmp_unsigned);
+#define PCT(p) (samples ? lat[(long)((samples - 1) * (p))] : 0)
+    printf("%-8s %7d %6s %12.0f %11ld %11ld %6.3f %8u %8u %8u%s\n",
+           type->name, threads, opt.pin ? "yes" : "no", total / elapsed, min, max,
+           sum_sq > 0 ? (double)total * total / (threads * sum_sq) : 1.0,
+           PCT(0.5), PCT(0.99), PCT(0.999),
+           counted == total ? "" : "  COUNTER MISMATCH");
+#undef PCT
+    if (opt.verbose) {
+        printf("  per thread:");
+        for (int i = 0; i < threads; i++)
+            printf(" %ld", workers[i].acquisitions);
+        printf("\n");
+    }
+    free(lat);
+    fflush(stdout);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-l lock,...] [-t max_threads] [-c cs_work] [-n ncs_work] [-s seconds] [-k flush] [-p] [-v]\n"
+            "  -l  locks to run (default all):", prog);
+    for (int i = 0; i < NUM_LOCK_TYPES; i++)
+        fprintf(stderr, " %s", lock_types[i].name);
+    fprintf(stderr, "\n"
+            "  -t  run 1, 2, 4, ... up to this many threads (default: online CPUs)\n"
+            "  -c  busy-loop iterations inside the lock (default %d)\n"
+            "  -n  busy-loop iterations between acquisitions (default %d)\n"
+            "  -s  seconds per case (default %.1f)\n"
+            "  -k  increments the approx counter batches per thread (default %ld)\n"
+            "  -p  pin thread i to CPU i mod CPUs\n"
+            "  -v  also list every thread's acquisition count\n",
+            opt.cs_work, opt.ncs_work, opt.seconds, approx_flush);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    int max_threads = sysconf(_SC_NPROCESSORS_ONLN), c;
+    char *locks = NULL;
+    while ((c = getopt(argc, argv, "l:t:c:n:s:k:pv")) != -1) {
+        switch (c) {
+        case 'l': locks = optarg; break;
+        case 't': max_threads = atoi(optarg); break;
+        case 'c': opt.cs_work = atoi(optarg); break;
+        case 'n': opt.ncs_work = atoi(optarg); break;
+        case 's': opt.seconds = atof(optarg); break;
+        case 'k': approx_flush = atol(optarg); break;
+        case 'p': opt.pin = 1; break;
+        case 'v': opt.verbose = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (max_threads < 1 || max_threads > MAX_THREADS || opt.seconds <= 0 || approx_flush < 1)
+        usage(argv[0]);
+
+    int selected[NUM_LOCK_TYPES] = { 0 };
+    for (char *save, *name = locks ? strtok_r(locks, ",", &save) : NULL; name; name = strtok_r(NULL, ",", &save)) {
+        int i = 0;
+        while (i < NUM_LOCK_TYPES && strcmp(lock_types[i].name, name) != 0)
+            i++;
+        if (i == NUM_LOCK_TYPES) {
+            fprintf(stderr, "lockbench: unknown lock '%s'\n", name);
+            usage(argv[0]);
+        }
+        selected[i] = 1;
+    }
+    for (int i = 0; i < max_threads; i++)
+        workers[i].latency = malloc(LAT_SAMPLES * sizeof(unsigned));
+
+    printf("# cs_work %d, ncs_work %d, %.2fs per case, %ld online CPUs\n",
+           opt.cs_work, opt.ncs_work, opt.seconds, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-8s %7s %6s %12s %11s %11s %6s %8s %8s %8s\n", "lock", "threads", "pinned",
+           "acq/s", "min/thread", "max/thread", "jain", "p50 ns", "p99 ns", "p99.9 ns");
+    for (int i = 0; i < NUM_LOCK_TYPES; i++) {
+        if (locks && !selected[i])
+            continue;
+        for (int t = 1; ; t = t * 2 > max_threads ? max_threads : t * 2) {
+            run_case(&lock_types[i], t);
+            if (t == max_threads)
+                break;
+        }
+    }
+    return 0;
+}
@@ -4,6 +4,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/syscall.h>
+#include "../common/matrix.h"
+#include "../common/loader.h"
+#include "../common/writer.h"
+#include "../common/fixed.h"
 
 #define matrix_row_x 1234
 #define matrix_col_x 250
@@ -11,66 +15,31 @@
 #define matrix_row_y 250
 #define matrix_col_y 4
 
-FILE *fptr1;
-FILE *fptr2;
 FILE *fptr3;
-int **x;
-int **y;
+struct matrix x;    // row-major
+struct matrix y;    // column-major, so each column of the product is one contiguous walk
+struct matrix z;
 
 
-// Put file data intp x array
+// Put file data into x and y
 void data_processing(void){
-    int tmp;
-    fscanf(fptr1, "%d", &tmp);
-    fscanf(fptr1, "%d", &tmp);
-    for(int i=0; i<matrix_row_x; i++){
-        for(int j=0; j<matrix_col_x; j++){
-            if (fscanf(fptr1, "%d", &x[i][j])!=1){
-                printf("Error reading from file");
-                return;
-            }
-        }
-    }
-
-    fscanf(fptr2, "%d", &tmp);
-    fscanf(fptr2, "%d", &tmp);
-     for(int i=0; i<matrix_row_y; i++){
-        for(int j=0; j<matrix_col_y; j++){
-            if (fscanf(fptr2, "%d", &y[i][j])!=1){
-                printf("Error reading from file");
-                return;
-            }
-        }
-    }   
+    if (matrix_load(&x, "m1.txt") != 0 || matrix_load(&y, "m2.txt") != 0)
+        exit(1);
 }
 
 void *thread(void *arg){
-    int res;
-    for(int i=0; i<matrix_row_x; i++){
-        for(int j=0; j<matrix_col_y; j++){
-            res = 0;
-            for(int k=0; k<matrix_row_y; k++){
-                res += x[i][k] * y[k][j];
-            }
-            fprintf(fptr3, "%d ", res);
-            if(j==matrix_col_y-1) fprintf(fptr3, "\n");        
-        }
-    }
+    fixed_gemm(&x, &y, &z);
     return NULL;
 }
 
 
 int main(){
-    x = malloc(sizeof(int*)*matrix_row_x);
-    for(int i=0; i<matrix_row_x; i++){
-        x[i] = malloc(sizeof(int)*matrix_col_x);
+    if (matrix_init(&x, matrix_row_x, matrix_col_x, MATRIX_ROW_MAJOR) != 0 ||
+        matrix_init(&y, matrix_row_y, matrix_col_y, MATRIX_COL_MAJOR) != 0 ||
+        matrix_init(&z, matrix_row_x, matrix_col_y, MATRIX_ROW_MAJOR) != 0){
+        printf("Error allocating matrices");
+        return 1;
     }
-    y = malloc(sizeof(int*)*matrix_row_y);
-    for(int i=0; i<matrix_row_y; i++){
-        y[i] = malloc(sizeof(int)*matrix_col_y);
-    }
-    fptr1 = fopen("m1.txt", "r");
-    fptr2 = fopen("m2.txt", "r");
     fptr3 = fopen("2.txt", "a");
     pthread_t t1;
     data_processing();
@@ -78,9 +47,8 @@ int main(){
 
     pthread_create(&t1, NULL, thread, NULL);
     pthread_join(t1, NULL);
+    if (matrix_write(fptr3, &z) != 0)
+        perror("Error writing output");
 
-
-    fclose(fptr1);
-    fclose(fptr2);
     fclose(fptr3);
 }
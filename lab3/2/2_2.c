@@ -3,6 +3,11 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include "../common/matrix.h"
+#include "../common/loader.h"
+#include "../common/writer.h"
+#include "../common/gemm.h"
 
 #define matrix_row_x 1234
 #define matrix_col_x 250
@@ -10,48 +15,50 @@
 #define matrix_row_y 250
 #define matrix_col_y 4
 
+#define MAX_THREADS 64
+
+#ifdef LOCK_IMPL
+// built with a lock from ../common/locks.h instead of the pthread spinlock (make judge2 LOCK=...)
+#include "../common/locks.h"
+lock_t lock;
+#define spin_init(l) lock_init(l)
+#define spin_lock(l) lock_acquire(l)
+#define spin_unlock(l) lock_release(l)
+#define spin_destroy(l) ((void)0)
+#define spin_name LOCK_NAME
+#else
 pthread_spinlock_t lock;
-FILE *fptr1;
-FILE *fptr2;
+#define spin_init(l) pthread_spin_init(l, 0)
+#define spin_lock(l) pthread_spin_lock(l)
+#define spin_unlock(l) pthread_spin_unlock(l)
+#define spin_destroy(l) pthread_spin_destroy(l)
+#define spin_name "spinlock"
+#endif
+int threads;                        // -k: k-split thread count, 0 for the two spinlock threads
+int row_threads;                    // -r: row-split thread count, 0 when not splitting rows
+struct matrix partial[MAX_THREADS]; // -k: each thread's share of z
+pthread_barrier_t partials_done;
 FILE *fptr3;
-int **x;
-int **y;
-int **z;
+struct matrix x;    // row-major
+struct matrix y;    // column-major, so each column of the product is one contiguous walk
+struct matrix z;
 
-// Put file data intp x array
+// Put file data into x and y
 void data_processing(void){
-    int tmp;
-    fscanf(fptr1, "%d", &tmp);
-    fscanf(fptr1, "%d", &tmp);
-    for(int i=0; i<matrix_row_x; i++){
-        for(int j=0; j<matrix_col_x; j++){
-            if (fscanf(fptr1, "%d", &x[i][j])!=1){
-                printf("Error reading from file");
-                return;
-            }
-        }
-    }
-
-    fscanf(fptr2, "%d", &tmp);
-    fscanf(fptr2, "%d", &tmp);
-     for(int i=0; i<matrix_row_y; i++){
-        for(int j=0; j<matrix_col_y; j++){
-            if (fscanf(fptr2, "%d", &y[i][j])!=1){
-                printf("Error reading from file");
-                return;
-            }
-        }
-    }   
+    if (matrix_load(&x, "m1.txt") != 0 || matrix_load(&y, "m2.txt") != 0)
+        exit(1);
 }
 
 void *thread1(void *arg){
 
     for(int i=0; i<matrix_row_x; i++){
+        const int *xi = &MAT_AT(&x, i, 0);
         for(int j=0; j<matrix_col_y; j++){
+            const int *yj = &MAT_AT(&y, 0, j);
             for(int k=0; k<matrix_row_y/2; k++){
-                pthread_spin_lock(&lock);
-                z[i][j] += x[i][k] * y[k][j];
-                pthread_spin_unlock(&lock);
+                spin_lock(&lock);
+                MAT_AT(&z, i, j) += xi[k] * yj[k];
+                spin_unlock(&lock);
             }      
         }
     }
@@ -61,52 +68,133 @@ void *thread1(void *arg){
 void *thread2(void *arg) {
 
     for(int i=0; i<matrix_row_x; i++){
+        const int *xi = &MAT_AT(&x, i, 0);
         for(int j=0; j<matrix_col_y; j++){
+            const int *yj = &MAT_AT(&y, 0, j);
             for(int k=matrix_row_y/2; k<matrix_row_y; k++){
-                pthread_spin_lock(&lock);
-                z[i][j] += x[i][k] * y[k][j];
-                pthread_spin_unlock(&lock);
+                spin_lock(&lock);
+                MAT_AT(&z, i, j) += xi[k] * yj[k];
+                spin_unlock(&lock);
             }
         }
     } 
     return NULL;
 }
 
-int main() {
-    x = malloc(sizeof(int*)*matrix_row_x);
+// -k mode: thread t sums its slice of k for each element of z in a register
+// and stores it in its own partial, so nothing is shared while multiplying.
+// Once every partial is complete the same threads add them up, each for its
+// own slice of the rows of z.
+void *ksplit_thread(void *arg){
+    int t = (int)(long)arg;
+    int k0 = matrix_row_y * t / threads, k1 = matrix_row_y * (t + 1) / threads;
     for(int i=0; i<matrix_row_x; i++){
-        x[i] = malloc(sizeof(int)*matrix_col_x);
+        const int *xi = &MAT_AT(&x, i, 0);
+        for(int j=0; j<matrix_col_y; j++){
+            const int *yj = &MAT_AT(&y, 0, j);
+            unsigned sum = 0;
+            for(int k=k0; k<k1; k++)
+                sum += (unsigned)xi[k] * (unsigned)yj[k];
+            MAT_AT(&partial[t], i, j) = (int)sum;
+        }
     }
-    y = malloc(sizeof(int*)*matrix_row_y);
-    for(int i=0; i<matrix_row_y; i++){
-        y[i] = malloc(sizeof(int)*matrix_col_y);
+
+    pthread_barrier_wait(&partials_done);
+    int i0 = matrix_row_x * t / threads, i1 = matrix_row_x * (t + 1) / threads;
+    for(int i=i0; i<i1; i++){
+        for(int j=0; j<matrix_col_y; j++){
+            unsigned sum = 0;
+            for(int p=0; p<threads; p++)
+                sum += (unsigned)MAT_AT(&partial[p], i, j);
+            MAT_AT(&z, i, j) = (int)sum;
+        }
     }
-    z = malloc(sizeof(int*)*matrix_row_x);
-    for(int i=0; i<matrix_row_x; i++){
-        z[i] = malloc(sizeof(int)*matrix_col_y);
+    return NULL;
+}
+
+// -r mode: thread t multiplies its own slice of the rows of x. y has only
+// a few columns, so gemm() takes its skinny kernel, which streams each row
+// of x once with a register of sums per column of y.
+void *rows_thread(void *arg){
+    int t = (int)(long)arg;
+    gemm_rows(&x, &y, &z, matrix_row_x * t / row_threads, matrix_row_x * (t + 1) / row_threads);
+    return NULL;
+}
+
+double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    int opt, timing = 0;
+    while ((opt = getopt(argc, argv, "k:r:t")) != -1){
+        if (opt == 'k' && atoi(optarg) >= 1 && atoi(optarg) <= MAX_THREADS){
+            threads = atoi(optarg);
+            row_threads = 0;
+        } else if (opt == 'r' && atoi(optarg) >= 1 && atoi(optarg) <= MAX_THREADS){
+            row_threads = atoi(optarg);
+            threads = 0;
+        } else if (opt == 't'){
+            timing = 1;
+        } else {
+            fprintf(stderr, "usage: %s [-k threads | -r threads (1-%d)] [-t]\n", argv[0], MAX_THREADS);
+            return 2;
+        }
+    }
+    if (matrix_init(&x, matrix_row_x, matrix_col_x, MATRIX_ROW_MAJOR) != 0 ||
+        matrix_init(&y, matrix_row_y, matrix_col_y, MATRIX_COL_MAJOR) != 0 ||
+        matrix_init(&z, matrix_row_x, matrix_col_y, MATRIX_ROW_MAJOR) != 0){
+        printf("Error allocating matrices");
+        return 1;
     }
-    fptr1 = fopen("m1.txt", "r");
-    fptr2 = fopen("m2.txt", "r");
     fptr3 = fopen("2.txt", "a");
     pthread_t t1, t2;
     data_processing();
     fprintf(fptr3, "%d %d\n", matrix_row_x, matrix_col_y);
 
-    pthread_spin_init(&lock, 0);
-    pthread_create(&t1, NULL, thread1, NULL);
-    pthread_create(&t2, NULL, thread2, NULL);
-    pthread_join(t1, NULL);
-    pthread_join(t2, NULL);
-    pthread_spin_destroy(&lock);
-
-    //Write output matrix into file.
-    for(int i=0; i<matrix_row_x; i++){
-        for(int j=0; j<matrix_col_y; j++){
-            fprintf(fptr3, "%d ", z[i][j]);
-            if(j==matrix_col_y-1) fprintf(fptr3, "\n");   
+    for (int t = 0; t < threads; t++){
+        if (matrix_init(&partial[t], matrix_row_x, matrix_col_y, MATRIX_ROW_MAJOR) != 0){
+            printf("Error allocating matrices");
+            return 1;
         }
     }
-    fclose(fptr1);
-    fclose(fptr2);
+
+    double begin = now();
+    if (row_threads > 0){
+        pthread_t tids[MAX_THREADS];
+        for (int t = 0; t < row_threads; t++)
+            pthread_create(&tids[t], NULL, rows_thread, (void *)(long)t);
+        for (int t = 0; t < row_threads; t++)
+            pthread_join(tids[t], NULL);
+    } else if (threads > 0){
+        pthread_t tids[MAX_THREADS];
+        pthread_barrier_init(&partials_done, NULL, threads);
+        for (int t = 0; t < threads; t++)
+            pthread_create(&tids[t], NULL, ksplit_thread, (void *)(long)t);
+        for (int t = 0; t < threads; t++)
+            pthread_join(tids[t], NULL);
+        pthread_barrier_destroy(&partials_done);
+    } else {
+        spin_init(&lock);
+        pthread_create(&t1, NULL, thread1, NULL);
+        pthread_create(&t2, NULL, thread2, NULL);
+        pthread_join(t1, NULL);
+        pthread_join(t2, NULL);
+        spin_destroy(&lock);
+    }
+    if (timing && row_threads > 0)
+        fprintf(stderr, "row split, %2d threads: %8.3f ms\n", row_threads, (now() - begin) * 1e3);
+    else if (timing && threads > 0)
+        fprintf(stderr, "k-split, %2d threads: %8.3f ms\n", threads, (now() - begin) * 1e3);
+    else if (timing)
+        fprintf(stderr, "%s, 2 threads: %8.3f ms\n", spin_name, (now() - begin) * 1e3);
+    for (int t = 0; t < threads; t++)
+        matrix_free(&partial[t]);
+
+    //Write output matrix into file.
+    if (matrix_write(fptr3, &z) != 0)
+        perror("Error writing output");
     fclose(fptr3);
 }
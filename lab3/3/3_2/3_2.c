@@ -5,7 +5,12 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdbool.h>
-#include "3_2_Config.h"
+#include "../../common/matrix.h"
+#include "../../common/loader.h"
+#include "../../common/writer.h"
+#include "../../common/gemm.h"
+#include "../../common/pool.h"
+#include "../../common/strassen.h"
 
 #define matrix_row_x 1234
 #define matrix_col_x 250
@@ -13,152 +18,92 @@
 #define matrix_row_y 250
 #define matrix_col_y 1234
 
-FILE *fptr1;
-FILE *fptr2;
+// z is computed in TILE_ROWS x TILE_COLS tiles, one pool task each
+#define TILE_ROWS 64
+#define TILE_COLS 128
+
 FILE *fptr3;
-FILE *fptr4;
-FILE *fptr5;
-int **x;
-int **y;
-int **z;
-pid_t tid1, tid2;
+FILE *readers[POOL_MAX_WORKERS];    // one /proc/Mythread_info reader per worker
+struct matrix x;    // row-major
+struct matrix y;    // column-major, so each column of the product is one contiguous walk
+struct matrix z;
+int tile_cols = (matrix_col_y + TILE_COLS - 1) / TILE_COLS;
 
-// Put file data intp x array
+// Put file data into x and y
 void data_processing(void){
-    int tmp;
-    fscanf(fptr1, "%d", &tmp);
-    fscanf(fptr1, "%d", &tmp);
-    for(int i=0; i<matrix_row_x; i++){
-        for(int j=0; j<matrix_col_x; j++){
-            if (fscanf(fptr1, "%d", &x[i][j])!=1){
-                printf("Error reading from file");
-                return;
-            }
-        }
-    }
-
-    fscanf(fptr2, "%d", &tmp);
-    fscanf(fptr2, "%d", &tmp);
-     for(int i=0; i<matrix_row_y; i++){
-        for(int j=0; j<matrix_col_y; j++){
-            if (fscanf(fptr2, "%d", &y[i][j])!=1){
-                printf("Error reading from file");
-                return;
-            }
-        }
-    }   
+    if (matrix_load(&x, "m1.txt") != 0 || matrix_load(&y, "m2.txt") != 0)
+        exit(1);
 }
 
-void *thread1(void *arg){
-    char data[30];
-    sprintf(data, "%s", "Thread 1 says hello!");
-
-#if (THREAD_NUMBER == 1)
-    for(int i=0; i<matrix_row_x; i++){
-        for(int j=0; j<matrix_col_y; j++){
-            for(int k=0; k<matrix_row_y; k++){
-                z[i][j] += x[i][k] * y[k][j];
-            }      
-        }
-    }
-#elif (THREAD_NUMBER == 2)
-    for(int i=0; i<matrix_row_x/2; i++){
-        for(int j=0; j<matrix_col_y; j++){
-            for(int k=0; k<matrix_row_y; k++){
-                z[i][j] += x[i][k] * y[k][j];
-            }      
-        }
-    }
-#endif
+void multiply_tile(int task, int worker, void *arg){
+    int i0 = task / tile_cols * TILE_ROWS, j0 = task % tile_cols * TILE_COLS;
+    int rows = matrix_row_x - i0 < TILE_ROWS ? matrix_row_x - i0 : TILE_ROWS;
+    int cols = matrix_col_y - j0 < TILE_COLS ? matrix_col_y - j0 : TILE_COLS;
+    struct matrix xs = matrix_view(&x, i0, 0, rows, matrix_col_x);
+    struct matrix ys = matrix_view(&y, 0, j0, matrix_row_y, cols);
+    struct matrix zs = matrix_view(&z, i0, j0, rows, cols);
+    gemm(&xs, &ys, &zs);
+}
 
-    /*YOUR CODE HERE*/
-    /* Hint: Write data into proc file.*/
+// Every worker reports itself through the proc file once its last tile is done
+void worker_done(int worker, void *arg){
     FILE *fp = fopen("/proc/Mythread_info", "w");
     if (fp == NULL){
         printf("Error opening file\n");
         exit(1);
     }
-    fprintf(fp, "Hello World from 1\n");
+    fprintf(fp, "Hello World from %d\n", worker + 1);
     fclose(fp);
-    /****************/ 
 
-    char buffer[50]; 
-    while (fgets(buffer, sizeof(buffer), fptr4) != NULL){
+    char buffer[50];
+    while (readers[worker] && fgets(buffer, sizeof(buffer), readers[worker]) != NULL){
         printf("%s", buffer);
     }
 }
 
-
-#if (THREAD_NUMBER == 2)
-void *thread2(void *arg){
-    char data[30];
-    sprintf(data, "%s", "Thread 2 says hello!");
-    for(int i=matrix_row_x/2; i<matrix_row_x; i++){
-        for(int j=0; j<matrix_col_y; j++){
-            for(int k=0; k<matrix_row_y; k++){
-                z[i][j] += x[i][k] * y[k][j];
-            }     
+int main(int argc, char *argv[]){
+    int workers = pool_default_workers();
+    int cutoff = 0;     // Strassen-Winograd below this size, plain tiles when 0
+    int opt;
+    while ((opt = getopt(argc, argv, "j:s:")) != -1){
+        if (opt == 'j' && atoi(optarg) >= 1 && atoi(optarg) <= POOL_MAX_WORKERS){
+            workers = atoi(optarg);
+        } else if (opt == 's' && atoi(optarg) >= 1){
+            cutoff = atoi(optarg);
+        } else {
+            fprintf(stderr, "usage: %s [-j threads (1-%d)] [-s strassen cutoff, e.g. %d]\n",
+                    argv[0], POOL_MAX_WORKERS, STRASSEN_THRESHOLD);
+            return 2;
         }
     }
-    
-    /*YOUR CODE HERE*/
-    /* Hint: Write data into proc file.*/
-    FILE *fp = fopen("/proc/Mythread_info", "w");
-    if (fp == NULL){
-        printf("Error opening file\n");
-        exit(1);
-    }
-    fprintf(fp, "Hello World from 2\n");
-    fclose(fp);
-    /****************/   
-
-    char buffer[50]; 
-    while (fgets(buffer, sizeof(buffer), fptr5) != NULL){
-        printf("%s", buffer);
-    } 
-}
-#endif
-
-int main(){
-    char buffer[50];
-    x = malloc(sizeof(int*)*matrix_row_x);
-    for(int i=0; i<matrix_row_x; i++){
-        x[i] = malloc(sizeof(int)*matrix_col_x);
-    }
-    y = malloc(sizeof(int*)*matrix_row_y);
-    for(int i=0; i<matrix_row_y; i++){
-        y[i] = malloc(sizeof(int)*matrix_col_y);
+    if (matrix_init(&x, matrix_row_x, matrix_col_x, MATRIX_ROW_MAJOR) != 0 ||
+        matrix_init(&y, matrix_row_y, matrix_col_y, MATRIX_COL_MAJOR) != 0 ||
+        matrix_init(&z, matrix_row_x, matrix_col_y, MATRIX_ROW_MAJOR) != 0){
+        printf("Error allocating matrices");
+        return 1;
     }
-    z = malloc(sizeof(int*)*matrix_row_x);
-    for(int i=0; i<matrix_row_x; i++){
-        z[i] = malloc(sizeof(int)*matrix_col_y);
-    }
-    fptr1 = fopen("m1.txt", "r");
-    fptr2 = fopen("m2.txt", "r");
     fptr3 = fopen("3_2.txt", "a");
-    fptr4 = fopen("/proc/Mythread_info", "r");
-    fptr5 = fopen("/proc/Mythread_info", "r");
+    for (int i = 0; i < workers; i++)
+        readers[i] = fopen("/proc/Mythread_info", "r");
 
-    pthread_t t1, t2;
     data_processing();
     fprintf(fptr3, "%d %d\n", matrix_row_x, matrix_col_y);
 
-    pthread_create(&t1, NULL, thread1, NULL);
-#if (THREAD_NUMBER==2)
-    pthread_create(&t2, NULL, thread2, NULL);
-#endif
-    pthread_join(t1, NULL);
-    pthread_join(t2, NULL);
-
-    for(int i=0; i<matrix_row_x; i++){
-        for(int j=0; j<matrix_col_y; j++){
-            fprintf(fptr3, "%d ", z[i][j]);
-            if(j==matrix_col_y-1) fprintf(fptr3, "\n");   
+    int tiles = (matrix_row_x + TILE_ROWS - 1) / TILE_ROWS * tile_cols;
+    if (cutoff > 0){
+        if (strassen(&x, &y, &z, cutoff, workers, worker_done, NULL) != 0){
+            printf("Error computing the product\n");
+            return 1;
         }
+    } else if (pool_run(workers, tiles, multiply_tile, worker_done, NULL, NULL) != 0){
+        printf("Error starting threads\n");
+        return 1;
     }
-    fclose(fptr1);
-    fclose(fptr2);
+
+    if (matrix_write(fptr3, &z) != 0)
+        perror("Error writing output");
     fclose(fptr3);
-    fclose(fptr4);
-    fclose(fptr5);
+    for (int i = 0; i < workers; i++)
+        if (readers[i])
+            fclose(readers[i]);
 }
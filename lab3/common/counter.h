@@ -0,0 +1,89 @@
+#ifndef COUNTER_H
+#define COUNTER_H
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+// Sharded counter for values bumped from many threads. Each thread owns a
+// shard on its own cache line and adds to it with a plain relaxed load and
+// store, so increments never contend; counter_read() sums the shards.
+// In approximate mode (flush_every > 0) a thread instead batches
+// flush_every increments privately and adds them to one global value, so a
+// read is a single load that lags by less than shards * flush_every;
+// counter_flush() publishes a shard's remainder, e.g. when its thread ends.
+// Header-only, like locks.h, so counter_add() inlines.
+
+#define COUNTER_CACHE_LINE 64
+
+struct counter_shard {
+    _Alignas(COUNTER_CACHE_LINE) atomic_long value;
+    long pending;           // approximate mode: not yet added to global
+};
+
+struct sharded_counter {
+    struct counter_shard *shards;
+    int count;
+    long flush_every;       // 0 for exact mode
+    _Alignas(COUNTER_CACHE_LINE) atomic_long global;
+};
+
+// Returns 0, or -1 if the shards could not be allocated
+static inline int counter_init(struct sharded_counter *c, int shards, long flush_every)
+{
+    c->shards = aligned_alloc(COUNTER_CACHE_LINE, shards * sizeof(struct counter_shard));
+    if (c->shards == NULL)
+        return -1;
+    for (int i = 0; i < shards; i++) {
+        atomic_init(&c->shards[i].value, 0);
+        c->shards[i].pending = 0;
+    }
+    c->count = shards;
+    c->flush_every = flush_every;
+    atomic_init(&c->global, 0);
+    return 0;
+}
+
+static inline void counter_free(struct sharded_counter *c)
+{
+    free(c->shards);
+    c->shards = NULL;
+}
+
+// Add n to the counter from the one thread that owns shard
+static inline void counter_add(struct sharded_counter *c, int shard, long n)
+{
+    struct counter_shard *s = &c->shards[shard];
+    if (c->flush_every > 0) {
+        if ((s->pending += n) >= c->flush_every) {
+            atomic_fetch_add_explicit(&c->global, s->pending, memory_order_relaxed);
+            s->pending = 0;
+        }
+        return;
+    }
+    // single writer: no locked read-modify-write needed, only an untorn store
+    atomic_store_explicit(&s->value, atomic_load_explicit(&s->value, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+// Approximate mode: publish what shard has batched; called by its owner
+static inline void counter_flush(struct sharded_counter *c, int shard)
+{
+    struct counter_shard *s = &c->shards[shard];
+    if (s->pending != 0) {
+        atomic_fetch_add_explicit(&c->global, s->pending, memory_order_relaxed);
+        s->pending = 0;
+    }
+}
+
+// Exact once writers have stopped (and, in approximate mode, flushed)
+static inline long counter_read(struct sharded_counter *c)
+{
+    long sum = atomic_load_explicit(&c->global, memory_order_relaxed);
+    if (c->flush_every > 0)
+        return sum;
+    for (int i = 0; i < c->count; i++)
+        sum += atomic_load_explicit(&c->shards[i].value, memory_order_relaxed);
+    return sum;
+}
+
+#endif
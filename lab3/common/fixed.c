@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "fixed.h"
+#include "gemm.h"
+#include "skinny.h"
+
+#define FIXED_KERNEL(name, attr, K, N, VEC)                                         \
+    attr static void name(const struct matrix *a, const struct matrix *b,           \
+                          struct matrix *c, int row_begin, int row_end)             \
+    {                                                                               \
+        SKINNY_ROWS(K, N, VEC);                                                     \
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FIXED_X86 1
+static int has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+static int has_avx512(void) { return __builtin_cpu_supports("avx512f"); }
+
+// Portable, AVX2 and AVX-512 builds of the same body, like the gemm() kernels
+#define FIXED_SHAPE(M, K, N)                                                                \
+    FIXED_KERNEL(fixed_c_##M##x##K##x##N, , K, N, skinny_v8)                                        \
+    FIXED_KERNEL(fixed_avx2_##M##x##K##x##N, __attribute__((target("avx2"))), K, N, skinny_v8)      \
+    FIXED_KERNEL(fixed_avx512_##M##x##K##x##N, __attribute__((target("avx512f"))), K, N, skinny_v16)
+#define FIXED_ENTRIES(M, K, N)                                                              \
+    { "avx512-" #M "x" #K "x" #N, M, K, N, fixed_avx512_##M##x##K##x##N, has_avx512 },      \
+    { "avx2-" #M "x" #K "x" #N, M, K, N, fixed_avx2_##M##x##K##x##N, has_avx2 },            \
+    { "c-" #M "x" #K "x" #N, M, K, N, fixed_c_##M##x##K##x##N, NULL },
+#else
+#define FIXED_SHAPE(M, K, N) FIXED_KERNEL(fixed_c_##M##x##K##x##N, , K, N, skinny_v8)
+#define FIXED_ENTRIES(M, K, N) { "c-" #M "x" #K "x" #N, M, K, N, fixed_c_##M##x##K##x##N, NULL },
+#endif
+
+// The shapes the lab programs multiply: lab3/2 and 3_1
+FIXED_SHAPE(1234, 250, 4)
+
+const struct fixed_kernel fixed_kernels[] = {
+    FIXED_ENTRIES(1234, 250, 4)
+    { NULL, 0, 0, 0, NULL, NULL },
+};
+
+static const char *want;    // $GEMM_FIXED: "0" for none, or one kernel's name
+
+static void check_env(void)
+{
+    want = getenv("GEMM_FIXED");
+    if (want && want[0] == '\0')
+        want = NULL;
+}
+
+// The kernel generated for this product, or NULL when the shape or the
+// layouts don't match one (or $GEMM_FIXED rules it out) and gemm() has to do it
+const struct fixed_kernel *fixed_kernel_find(const struct matrix *a, const struct matrix *b, const struct matrix *c)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, check_env);
+    if ((want && strcmp(want, "0") == 0) || a->cs != 1 || b->rs != 1)
+        return NULL;
+    for (const struct fixed_kernel *k = fixed_kernels; k->name; k++)
+        if (k->m == c->rows && k->k == a->cols && k->n == c->cols && (!k->usable || k->usable()) &&
+            (!want || strcmp(want, k->name) == 0))
+            return k;
+    return NULL;
+}
+
+// C += A * B through a generated kernel when there is one, gemm() otherwise
+void fixed_gemm(const struct matrix *a, const struct matrix *b, struct matrix *c)
+{
+    fixed_gemm_rows(a, b, c, 0, c->rows);
+}
+
+// Rows [row_begin, row_end) of C += the same rows of A times B, for splitting work between threads
+void fixed_gemm_rows(const struct matrix *a, const struct matrix *b, struct matrix *c, int row_begin, int row_end)
+{
+    const struct fixed_kernel *k = fixed_kernel_find(a, b, c);
+    if (k)
+        k->fn(a, b, c, row_begin, row_end);
+    else
+        gemm_rows(a, b, c, row_begin, row_end);
+}
@@ -0,0 +1,34 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include "matrix.h"
+
+// Kernels generated for one product shape. The lab programs know their
+// dimensions at compile time, and for a skinny B the packing and tiling of
+// gemm() cost more than the multiply, so fixed.c expands FIXED_SHAPE(M, K, N)
+// into the SKINNY_ROWS body of skinny.h with K a constant: every k and j
+// loop has a known trip count, the compiler unrolls them, keeps N vectors
+// of sums in registers and only peels the K % lanes tail. A is read
+// row-major and B column-major (the layouts the programs load), each row
+// of A once for all N columns.
+
+// rows [row_begin, row_end) of C += the same rows of A times B
+typedef void (*fixed_kernel_fn)(const struct matrix *a, const struct matrix *b, struct matrix *c,
+                                int row_begin, int row_end);
+
+struct fixed_kernel {
+    const char *name;
+    int m, k, n;
+    fixed_kernel_fn fn;
+    int (*usable)(void);    // CPU check, NULL for portable kernels
+};
+
+// terminated by a NULL name, fastest first for each shape; $GEMM_FIXED=<name> forces
+// one entry and $GEMM_FIXED=0 ignores them all
+extern const struct fixed_kernel fixed_kernels[];
+
+const struct fixed_kernel *fixed_kernel_find(const struct matrix *a, const struct matrix *b, const struct matrix *c);
+void fixed_gemm(const struct matrix *a, const struct matrix *b, struct matrix *c);
+void fixed_gemm_rows(const struct matrix *a, const struct matrix *b, struct matrix *c, int row_begin, int row_end);
+
+#endif
@@ -0,0 +1,453 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEMM_X86 1
+#endif
+#include "gemm.h"
+#include "skinny.h"
+
+#define MAX_MR 16
+#define MAX_NR 32
+
+// Portable micro-kernel; the fixed trip counts let the compiler unroll and
+// vectorise the tile. Arithmetic is unsigned so overflow wraps like the
+// hardware does instead of being undefined.
+static void kernel_c_4x8(int kc, const int *a, const int *b, int *c, ptrdiff_t rs, ptrdiff_t cs)
+{
+    unsigned acc[4][8] = { { 0 } };
+    for (int k = 0; k < kc; k++, a += 4, b += 8) {
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 8; j++)
+                acc[i][j] += (unsigned)a[i] * (unsigned)b[j];
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 8; j++)
+            c[i * rs + j * cs] = (int)((unsigned)c[i * rs + j * cs] + acc[i][j]);
+    }
+}
+
+#ifdef GEMM_X86
+// The SIMD kernels broadcast one element of the A panel and multiply it into
+// NR/lanes vectors of the B panel per row: vpmulld + vpaddd wrap mod 2^32
+// exactly like the scalar loop, so every kernel gives the same bits.
+// Each is compiled for its own ISA with a target attribute and is only
+// called after gemm_kernel_select() has checked the CPU supports it.
+
+// c rows += the accumulators of one row of the tile; the vector path needs contiguous rows
+#define TILE_ROW_ADD(store, load, add, type, lanes, ci, acc)                           \
+    do {                                                                               \
+        if (cs == 1) {                                                                 \
+            store((type *)(ci), add(load((const type *)(ci)), acc));                   \
+        } else {                                                                       \
+            int t_[lanes];                                                             \
+            store((type *)t_, acc);                                                    \
+            for (int j_ = 0; j_ < (lanes); j_++)                                       \
+                (ci)[j_ * cs] = (int)((unsigned)(ci)[j_ * cs] + (unsigned)t_[j_]);     \
+        }                                                                              \
+    } while (0)
+
+// row i of the tile, two vectors wide, from accumulators c<i>0 and c<i>1
+#define STORE_128(i)                                                                                    \
+    TILE_ROW_ADD(_mm_storeu_si128, _mm_loadu_si128, _mm_add_epi32, __m128i, 4, c + i * rs, c##i##0);    \
+    TILE_ROW_ADD(_mm_storeu_si128, _mm_loadu_si128, _mm_add_epi32, __m128i, 4, c + i * rs + 4 * cs, c##i##1)
+#define STORE_256(i)                                                                                            \
+    TILE_ROW_ADD(_mm256_storeu_si256, _mm256_loadu_si256, _mm256_add_epi32, __m256i, 8, c + i * rs, c##i##0);   \
+    TILE_ROW_ADD(_mm256_storeu_si256, _mm256_loadu_si256, _mm256_add_epi32, __m256i, 8, c + i * rs + 8 * cs, c##i##1)
+#define STORE_512(i)                                                                                            \
+    TILE_ROW_ADD(_mm512_storeu_si512, _mm512_loadu_si512, _mm512_add_epi32, __m512i, 16, c + i * rs, c##i##0);  \
+    TILE_ROW_ADD(_mm512_storeu_si512, _mm512_loadu_si512, _mm512_add_epi32, __m512i, 16, c + i * rs + 16 * cs, c##i##1)
+
+__attribute__((target("sse4.1")))
+static void kernel_sse41_4x8(int kc, const int *a, const int *b, int *c, ptrdiff_t rs, ptrdiff_t cs)
+{
+    __m128i c00 = _mm_setzero_si128(), c01 = c00, c10 = c00, c11 = c00;
+    __m128i c20 = c00, c21 = c00, c30 = c00, c31 = c00;
+    for (int k = 0; k < kc; k++, a += 4, b += 8) {
+        __m128i b0 = _mm_loadu_si128((const __m128i *)b);
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(b + 4));
+#define ROW(i)                                                              \
+        do {                                                                \
+            __m128i ai = _mm_set1_epi32(a[i]);                              \
+            c##i##0 = _mm_add_epi32(c##i##0, _mm_mullo_epi32(ai, b0));      \
+            c##i##1 = _mm_add_epi32(c##i##1, _mm_mullo_epi32(ai, b1));      \
+        } while (0)
+        ROW(0); ROW(1); ROW(2); ROW(3);
+#undef ROW
+    }
+    STORE_128(0); STORE_128(1); STORE_128(2); STORE_128(3);
+}
+
+__attribute__((target("avx2")))
+static void kernel_avx2_6x16(int kc, const int *a, const int *b, int *c, ptrdiff_t rs, ptrdiff_t cs)
+{
+    __m256i c00 = _mm256_setzero_si256(), c01 = c00, c10 = c00, c11 = c00, c20 = c00, c21 = c00;
+    __m256i c30 = c00, c31 = c00, c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    for (int k = 0; k < kc; k++, a += 6, b += 16) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)b);
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(b + 8));
+#define ROW(i)                                                                  \
+        do {                                                                    \
+            __m256i ai = _mm256_set1_epi32(a[i]);                               \
+            c##i##0 = _mm256_add_epi32(c##i##0, _mm256_mullo_epi32(ai, b0));    \
+            c##i##1 = _mm256_add_epi32(c##i##1, _mm256_mullo_epi32(ai, b1));    \
+        } while (0)
+        ROW(0); ROW(1); ROW(2); ROW(3); ROW(4); ROW(5);
+#undef ROW
+    }
+    STORE_256(0); STORE_256(1); STORE_256(2); STORE_256(3); STORE_256(4); STORE_256(5);
+}
+
+__attribute__((target("avx512f")))
+static void kernel_avx512_8x32(int kc, const int *a, const int *b, int *c, ptrdiff_t rs, ptrdiff_t cs)
+{
+    __m512i c00 = _mm512_setzero_si512(), c01 = c00, c10 = c00, c11 = c00, c20 = c00, c21 = c00;
+    __m512i c30 = c00, c31 = c00, c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    __m512i c60 = c00, c61 = c00, c70 = c00, c71 = c00;
+    for (int k = 0; k < kc; k++, a += 8, b += 32) {
+        __m512i b0 = _mm512_loadu_si512(b);
+        __m512i b1 = _mm512_loadu_si512(b + 16);
+#define ROW(i)                                                                  \
+        do {                                                                    \
+            __m512i ai = _mm512_set1_epi32(a[i]);                               \
+            c##i##0 = _mm512_add_epi32(c##i##0, _mm512_mullo_epi32(ai, b0));    \
+            c##i##1 = _mm512_add_epi32(c##i##1, _mm512_mullo_epi32(ai, b1));    \
+        } while (0)
+        ROW(0); ROW(1); ROW(2); ROW(3); ROW(4); ROW(5); ROW(6); ROW(7);
+#undef ROW
+    }
+    STORE_512(0); STORE_512(1); STORE_512(2); STORE_512(3);
+    STORE_512(4); STORE_512(5); STORE_512(6); STORE_512(7);
+}
+
+// int16 kernels: every 32-bit word of a panel holds elements k and k+1, so
+// one pmaddwd (or VNNI vpdpwssd) does two multiply-adds per lane where the
+// int32 kernels do one. A pair sum is at most 2 * 32768^2 = 2^31, which
+// wraps to the same 32 bits the int32 kernels produce.
+
+__attribute__((target("avx2")))
+static void kernel_avx2_i16_6x16(int kc, const int *a, const int *b, int *c, ptrdiff_t rs, ptrdiff_t cs)
+{
+    __m256i c00 = _mm256_setzero_si256(), c01 = c00, c10 = c00, c11 = c00, c20 = c00, c21 = c00;
+    __m256i c30 = c00, c31 = c00, c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    for (int k = 0; k < kc; k += 2, a += 6, b += 16) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)b);
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(b + 8));
+#define ROW(i)                                                                  \
+        do {                                                                    \
+            __m256i ai = _mm256_set1_epi32(a[i]);                               \
+            c##i##0 = _mm256_add_epi32(c##i##0, _mm256_madd_epi16(ai, b0));     \
+            c##i##1 = _mm256_add_epi32(c##i##1, _mm256_madd_epi16(ai, b1));     \
+        } while (0)
+        ROW(0); ROW(1); ROW(2); ROW(3); ROW(4); ROW(5);
+#undef ROW
+    }
+    STORE_256(0); STORE_256(1); STORE_256(2); STORE_256(3); STORE_256(4); STORE_256(5);
+}
+
+__attribute__((target("avx512bw")))
+static void kernel_avx512_i16_8x32(int kc, const int *a, const int *b, int *c, ptrdiff_t rs, ptrdiff_t cs)
+{
+    __m512i c00 = _mm512_setzero_si512(), c01 = c00, c10 = c00, c11 = c00, c20 = c00, c21 = c00;
+    __m512i c30 = c00, c31 = c00, c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    __m512i c60 = c00, c61 = c00, c70 = c00, c71 = c00;
+    for (int k = 0; k < kc; k += 2, a += 8, b += 32) {
+        __m512i b0 = _mm512_loadu_si512(b);
+        __m512i b1 = _mm512_loadu_si512(b + 16);
+#define ROW(i)                                                                  \
+        do {                                                                    \
+            __m512i ai = _mm512_set1_epi32(a[i]);                               \
+            c##i##0 = _mm512_add_epi32(c##i##0, _mm512_madd_epi16(ai, b0));     \
+            c##i##1 = _mm512_add_epi32(c##i##1, _mm512_madd_epi16(ai, b1));     \
+        } while (0)
+        ROW(0); ROW(1); ROW(2); ROW(3); ROW(4); ROW(5); ROW(6); ROW(7);
+#undef ROW
+    }
+    STORE_512(0); STORE_512(1); STORE_512(2); STORE_512(3);
+    STORE_512(4); STORE_512(5); STORE_512(6); STORE_512(7);
+}
+
+__attribute__((target("avx512f,avx512vnni")))
+static void kernel_vnni_i16_8x32(int kc, const int *a, const int *b, int *c, ptrdiff_t rs, ptrdiff_t cs)
+{
+    __m512i c00 = _mm512_setzero_si512(), c01 = c00, c10 = c00, c11 = c00, c20 = c00, c21 = c00;
+    __m512i c30 = c00, c31 = c00, c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    __m512i c60 = c00, c61 = c00, c70 = c00, c71 = c00;
+    for (int k = 0; k < kc; k += 2, a += 8, b += 32) {
+        __m512i b0 = _mm512_loadu_si512(b);
+        __m512i b1 = _mm512_loadu_si512(b + 16);
+#define ROW(i)                                                  \
+        do {                                                    \
+            __m512i ai = _mm512_set1_epi32(a[i]);               \
+            c##i##0 = _mm512_dpwssd_epi32(c##i##0, ai, b0);     \
+            c##i##1 = _mm512_dpwssd_epi32(c##i##1, ai, b1);     \
+        } while (0)
+        ROW(0); ROW(1); ROW(2); ROW(3); ROW(4); ROW(5); ROW(6); ROW(7);
+#undef ROW
+    }
+    STORE_512(0); STORE_512(1); STORE_512(2); STORE_512(3);
+    STORE_512(4); STORE_512(5); STORE_512(6); STORE_512(7);
+}
+
+static int has_sse41(void) { return __builtin_cpu_supports("sse4.1"); }
+static int has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+static int has_avx512(void) { return __builtin_cpu_supports("avx512f"); }
+static int has_avx512bw(void) { return __builtin_cpu_supports("avx512bw"); }
+static int has_vnni(void) { return __builtin_cpu_supports("avx512vnni"); }
+#endif
+
+// Skinny B (N <= GEMM_SKINNY_N): the SKINNY_ROWS body from skinny.h,
+// expanded for every N from 1 to GEMM_SKINNY_N so the column loops unroll
+// completely, with K taken from A at run time
+#define SKINNY_CASE(N, VEC) case N: SKINNY_ROWS(a->cols, N, VEC); break;
+#define SKINNY_KERNEL(name, attr, VEC)                                              \
+    attr static void name(const struct matrix *a, const struct matrix *b,           \
+                          struct matrix *c, int row_begin, int row_end)             \
+    {                                                                               \
+        switch (c->cols) {                                                          \
+        SKINNY_CASE(1, VEC) SKINNY_CASE(2, VEC) SKINNY_CASE(3, VEC)                 \
+        SKINNY_CASE(4, VEC) SKINNY_CASE(5, VEC) SKINNY_CASE(6, VEC)                 \
+        SKINNY_CASE(7, VEC) SKINNY_CASE(8, VEC) SKINNY_CASE(9, VEC)                 \
+        SKINNY_CASE(10, VEC) SKINNY_CASE(11, VEC) SKINNY_CASE(12, VEC)              \
+        SKINNY_CASE(13, VEC) SKINNY_CASE(14, VEC) SKINNY_CASE(15, VEC)              \
+        SKINNY_CASE(16, VEC)                                                        \
+        }                                                                           \
+    }
+
+_Static_assert(GEMM_SKINNY_N == 16, "SKINNY_KERNEL expands N = 1..16");
+
+SKINNY_KERNEL(skinny_c, , skinny_v8)
+#ifdef GEMM_X86
+SKINNY_KERNEL(skinny_avx2, __attribute__((target("avx2"))), skinny_v8)
+SKINNY_KERNEL(skinny_avx512, __attribute__((target("avx512f"))), skinny_v16)
+#endif
+
+const struct gemm_skinny_kernel gemm_skinny_kernels[] = {
+#ifdef GEMM_X86
+    { "skinny-avx512", skinny_avx512, has_avx512 },
+    { "skinny-avx2", skinny_avx2, has_avx2 },
+#endif
+    { "skinny-c", skinny_c, NULL },
+    { NULL, NULL, NULL },
+};
+
+// best first within each element width; the portable kernel is last and runs everywhere
+const struct gemm_kernel gemm_kernels[] = {
+#ifdef GEMM_X86
+    { "vnni-i16-8x32", 8, 32, 1, kernel_vnni_i16_8x32, has_vnni },
+    { "avx512-i16-8x32", 8, 32, 1, kernel_avx512_i16_8x32, has_avx512bw },
+    { "avx2-i16-6x16", 6, 16, 1, kernel_avx2_i16_6x16, has_avx2 },
+    { "avx512-8x32", 8, 32, 0, kernel_avx512_8x32, has_avx512 },
+    { "avx2-6x16", 6, 16, 0, kernel_avx2_6x16, has_avx2 },
+    { "sse4.1-4x8", 4, 8, 0, kernel_sse41_4x8, has_sse41 },
+#endif
+    { "c-4x8", 4, 8, 0, kernel_c_4x8, NULL },
+    { NULL, 0, 0, 0, NULL, NULL },
+};
+
+static const struct gemm_kernel *selected, *selected16;
+static const struct gemm_skinny_kernel *skinny;
+
+static const struct gemm_kernel *first_usable(int int16, const char *name)
+{
+    for (const struct gemm_kernel *k = gemm_kernels; k->name; k++) {
+        if (k->int16 == int16 && (!k->usable || k->usable()) && (!name || strcmp(name, k->name) == 0))
+            return k;
+    }
+    return NULL;
+}
+
+static const struct gemm_skinny_kernel *first_skinny(const char *name)
+{
+    for (const struct gemm_skinny_kernel *k = gemm_skinny_kernels; k->name; k++) {
+        if ((!k->usable || k->usable()) && (!name || strcmp(name, k->name) == 0))
+            return k;
+    }
+    return NULL;
+}
+
+static void select_once(void)
+{
+    const char *want = getenv("GEMM_KERNEL");
+    if (want && !*want)
+        want = NULL;
+    selected = first_usable(0, want);
+    selected16 = first_usable(1, want);
+    skinny = first_skinny(want);
+    if (want && !selected && !selected16 && !skinny) {
+        fprintf(stderr, "gemm: kernel '%s' is unknown or not supported here\n", want);
+        want = NULL;
+        selected16 = first_usable(1, NULL);
+        skinny = first_skinny(NULL);
+    }
+    // naming an int32 kernel leaves selected16 and skinny NULL and so turns
+    // the int16 and skinny paths off; naming an int16 or skinny one still
+    // needs an int32 kernel for the other products
+    if (!selected)
+        selected = first_usable(0, NULL);
+}
+
+// The fastest kernel this CPU runs for operands that do (narrow) or may not
+// fit in int16, or the one named by $GEMM_KERNEL
+const struct gemm_kernel *gemm_kernel_select(int narrow)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, select_once);
+    return narrow && selected16 ? selected16 : selected;
+}
+
+// a[i0:i0+mc, p0:p0+kc] as mr-tall panels, each k-major: panel[k*mr + i]; short panels are zero-padded
+static void pack_a(const struct matrix *a, int i0, int mc, int p0, int kc, int mr, int *dst)
+{
+    for (int ip = 0; ip < mc; ip += mr) {
+        int rows = mc - ip < mr ? mc - ip : mr;
+        for (int k = 0; k < kc; k++) {
+            for (int i = 0; i < rows; i++)
+                dst[i] = MAT_AT(a, i0 + ip + i, p0 + k);
+            for (int i = rows; i < mr; i++)
+                dst[i] = 0;
+            dst += mr;
+        }
+    }
+}
+
+// b[p0:p0+kc, j0:j0+nc] as nr-wide panels, each k-major: panel[k*nr + j]
+static void pack_b(const struct matrix *b, int p0, int kc, int j0, int nc, int nr, int *dst)
+{
+    for (int jp = 0; jp < nc; jp += nr) {
+        int cols = nc - jp < nr ? nc - jp : nr;
+        for (int k = 0; k < kc; k++) {
+            for (int j = 0; j < cols; j++)
+                dst[j] = MAT_AT(b, p0 + k, j0 + jp + j);
+            for (int j = cols; j < nr; j++)
+                dst[j] = 0;
+            dst += nr;
+        }
+    }
+}
+
+static int pair16(int lo, int hi)
+{
+    return (int)((unsigned)(unsigned short)lo | (unsigned)(unsigned short)hi << 16);
+}
+
+// pack_a() for the int16 kernels: word k/2 of a panel row holds elements k and k+1, an odd kc pads with 0
+static void pack_a16(const struct matrix *a, int i0, int mc, int p0, int kc, int mr, int *dst)
+{
+    for (int ip = 0; ip < mc; ip += mr) {
+        int rows = mc - ip < mr ? mc - ip : mr;
+        for (int k = 0; k < kc; k += 2) {
+            for (int i = 0; i < rows; i++)
+                dst[i] = pair16(MAT_AT(a, i0 + ip + i, p0 + k), k + 1 < kc ? MAT_AT(a, i0 + ip + i, p0 + k + 1) : 0);
+            for (int i = rows; i < mr; i++)
+                dst[i] = 0;
+            dst += mr;
+        }
+    }
+}
+
+static void pack_b16(const struct matrix *b, int p0, int kc, int j0, int nc, int nr, int *dst)
+{
+    for (int jp = 0; jp < nc; jp += nr) {
+        int cols = nc - jp < nr ? nc - jp : nr;
+        for (int k = 0; k < kc; k += 2) {
+            for (int j = 0; j < cols; j++)
+                dst[j] = pair16(MAT_AT(b, p0 + k, j0 + jp + j), k + 1 < kc ? MAT_AT(b, p0 + k + 1, j0 + jp + j) : 0);
+            for (int j = cols; j < nr; j++)
+                dst[j] = 0;
+            dst += nr;
+        }
+    }
+}
+
+static int round_up(int n, int to)
+{
+    return (n + to - 1) / to * to;
+}
+
+// C += A * B straight from the operands, for when the packing buffers can't be allocated
+static void gemm_unpacked(const struct matrix *a, const struct matrix *b, struct matrix *c)
+{
+    for (int i = 0; i < c->rows; i++) {
+        for (int j = 0; j < c->cols; j++) {
+            unsigned acc = 0;
+            for (int k = 0; k < a->cols; k++)
+                acc += (unsigned)MAT_AT(a, i, k) * (unsigned)MAT_AT(b, k, j);
+            MAT_AT(c, i, j) = (int)((unsigned)MAT_AT(c, i, j) + acc);
+        }
+    }
+}
+
+// C += A * B for any layouts and views of matching shapes
+void gemm(const struct matrix *a, const struct matrix *b, struct matrix *c)
+{
+    const struct gemm_kernel *kern = gemm_kernel_select(a->narrow && b->narrow);
+    int mr = kern->mr, nr = kern->nr;
+    int m = c->rows, n = c->cols, kdim = a->cols;
+    if (m == 0 || n == 0 || kdim == 0)
+        return;
+    // a few columns of B: stream A once instead of packing it
+    if (n <= GEMM_SKINNY_N && a->cs == 1 && b->rs == 1 && skinny) {
+        skinny->fn(a, b, c, 0, m);
+        return;
+    }
+    int nc_max = round_up(n < GEMM_NC ? n : GEMM_NC, nr);
+    int mc_max = round_up(m < GEMM_MC ? m : GEMM_MC, mr);
+    int kc_max = kdim < GEMM_KC ? kdim : GEMM_KC;
+    int *bp = aligned_alloc(MATRIX_ALIGN, round_up((size_t)kc_max * nc_max * sizeof(int), MATRIX_ALIGN));
+    int *ap = aligned_alloc(MATRIX_ALIGN, round_up((size_t)kc_max * mc_max * sizeof(int), MATRIX_ALIGN));
+    int edge[MAX_MR * MAX_NR];
+    if (ap == NULL || bp == NULL) {
+        free(ap);
+        free(bp);
+        gemm_unpacked(a, b, c);
+        return;
+    }
+
+    for (int j0 = 0; j0 < n; j0 += GEMM_NC) {
+        int nc = n - j0 < GEMM_NC ? n - j0 : GEMM_NC;
+        for (int p0 = 0; p0 < kdim; p0 += GEMM_KC) {
+            int kc = kdim - p0 < GEMM_KC ? kdim - p0 : GEMM_KC;
+            // words per panel row: one per k, or one per k pair for int16 kernels
+            int kw = kern->int16 ? (kc + 1) / 2 : kc;
+            (kern->int16 ? pack_b16 : pack_b)(b, p0, kc, j0, nc, nr, bp);
+            for (int i0 = 0; i0 < m; i0 += GEMM_MC) {
+                int mc = m - i0 < GEMM_MC ? m - i0 : GEMM_MC;
+                (kern->int16 ? pack_a16 : pack_a)(a, i0, mc, p0, kc, mr, ap);
+                for (int jr = 0; jr < nc; jr += nr) {
+                    const int *bpanel = bp + (size_t)jr * kw;
+                    int cols = nc - jr < nr ? nc - jr : nr;
+                    for (int ir = 0; ir < mc; ir += mr) {
+                        const int *apanel = ap + (size_t)ir * kw;
+                        int rows = mc - ir < mr ? mc - ir : mr;
+                        int *ct = &MAT_AT(c, i0 + ir, j0 + jr);
+                        if (rows == mr && cols == nr) {
+                            kern->fn(kc, apanel, bpanel, ct, c->rs, c->cs);
+                            continue;
+                        }
+                        // partial tile: run the kernel on a scratch tile and add the valid part
+                        memset(edge, 0, sizeof(int) * mr * nr);
+                        kern->fn(kc, apanel, bpanel, edge, nr, 1);
+                        for (int i = 0; i < rows; i++)
+                            for (int j = 0; j < cols; j++)
+                                ct[i * c->rs + j * c->cs] =
+                                    (int)((unsigned)ct[i * c->rs + j * c->cs] + (unsigned)edge[i * nr + j]);
+                    }
+                }
+            }
+        }
+    }
+    free(ap);
+    free(bp);
+}
+
+// Rows [row_begin, row_end) of C += the same rows of A times B, for splitting work between threads
+void gemm_rows(const struct matrix *a, const struct matrix *b, struct matrix *c, int row_begin, int row_end)
+{
+    struct matrix as = matrix_view(a, row_begin, 0, row_end - row_begin, a->cols);
+    struct matrix cs = matrix_view(c, row_begin, 0, row_end - row_begin, c->cols);
+    gemm(&as, b, &cs);
+}
@@ -0,0 +1,53 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <stddef.h>
+#include "matrix.h"
+
+// Blocked GEMM: C += A * B on int32 with wrap-around arithmetic.
+// B is packed KC x NC at a time into NR-wide column panels (L2/L3),
+// A MC x KC at a time into MR-tall row panels (L1/L2), and a micro-kernel
+// keeps an MR x NR tile of C in registers across the whole KC loop, so C
+// is read and written once per tile per KC block.
+
+#define GEMM_MC 64
+#define GEMM_KC 256
+#define GEMM_NC 2048
+
+// MR x NR tile of C (elements at c[i*rs + j*cs]) += packed A panel * packed B panel over kc.
+// int16 kernels take panels with k and k+1 packed into each word (low half first).
+typedef void (*gemm_kernel_fn)(int kc, const int *a, const int *b, int *c, ptrdiff_t rs, ptrdiff_t cs);
+
+struct gemm_kernel {
+    const char *name;
+    int mr, nr;
+    int int16;              // only for operands that fit in int16 (matrix.narrow)
+    gemm_kernel_fn fn;
+    int (*usable)(void);    // CPU check, NULL for portable kernels
+};
+
+// terminated by a NULL name; $GEMM_KERNEL=<name> forces one entry
+extern const struct gemm_kernel gemm_kernels[];
+
+// Products with at most GEMM_SKINNY_N columns, A row-major and B
+// column-major skip the packing: rows [row_begin, row_end) of C += A * B,
+// each row of A streamed once with every column's sums in registers.
+#define GEMM_SKINNY_N 16
+
+typedef void (*gemm_skinny_fn)(const struct matrix *a, const struct matrix *b, struct matrix *c,
+                               int row_begin, int row_end);
+
+struct gemm_skinny_kernel {
+    const char *name;
+    gemm_skinny_fn fn;
+    int (*usable)(void);
+};
+
+// terminated by a NULL name, best first; $GEMM_KERNEL can name these too
+extern const struct gemm_skinny_kernel gemm_skinny_kernels[];
+
+const struct gemm_kernel *gemm_kernel_select(int narrow);
+void gemm(const struct matrix *a, const struct matrix *b, struct matrix *c);
+void gemm_rows(const struct matrix *a, const struct matrix *b, struct matrix *c, int row_begin, int row_end);
+
+#endif
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "loader.h"
+#include "matfile.h"
+
+// Text matrix loader: the file is mmap'd and its body split into chunks at
+// whitespace, one per thread. Each thread first counts the numbers in its
+// chunk; a prefix sum of the counts gives every chunk the index of its first
+// element, and a second pass parses straight into the matrix.
+
+#define MAX_THREADS 64
+
+struct chunk {
+    const char *begin, *end;
+    long first, count;      // index of the chunk's first element, numbers in it
+    const char *error;      // first malformed byte, NULL if none
+    const char *message;
+    int wide;               // some element is outside the int16 range
+    struct matrix *m;
+};
+
+static int is_space(unsigned char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static void *count_numbers(void *arg)
+{
+    struct chunk *c = arg;
+    long n = 0;
+    int prev_space = 1;
+    for (const char *p = c->begin; p < c->end; p++) {
+        int space = is_space(*p);
+        n += prev_space & !space;
+        prev_space = space;
+    }
+    c->count = n;
+    return NULL;
+}
+
+// Parse one optionally negative decimal int at *pp, advancing past it.
+// Returns 0, or -1 with *pp left on the offending byte.
+static int parse_int(const char **pp, const char *end, int *out, const char **message)
+{
+    const char *p = *pp;
+    int neg = *p == '-';
+    p += neg;
+    const char *digits = p;
+    unsigned long long v = 0;
+    unsigned d;
+    while (p < end && (d = (unsigned char)*p - '0') < 10) {
+        v = v * 10 + d;
+        p++;
+        if (v > 2147483648ull) {
+            *message = "number does not fit in an int";
+            *pp = digits;
+            return -1;
+        }
+    }
+    if (p == digits || (p < end && !is_space(*p))) {
+        *message = "expected an integer";
+        *pp = p;
+        return -1;
+    }
+    if (!neg && v == 2147483648ull) {
+        *message = "number does not fit in an int";
+        *pp = digits;
+        return -1;
+    }
+    *out = neg ? (int)-v : (int)v;
+    *pp = p;
+    return 0;
+}
+
+static void *parse_numbers(void *arg)
+{
+    struct chunk *c = arg;
+    struct matrix *m = c->m;
+    long total = (long)m->rows * m->cols;
+    long idx = c->first;
+    int i = idx / m->cols, j = idx % m->cols;
+    const char *p = c->begin;
+    for (;;) {
+        while (p < c->end && is_space(*p))
+            p++;
+        if (p == c->end)
+            break;
+        if (idx == total) {
+            c->error = p;
+            c->message = "more numbers than the header declares";
+            return NULL;
+        }
+        int *e = &MAT_AT(m, i, j);
+        if (parse_int(&p, c->end, e, &c->message) != 0) {
+            c->error = p;
+            return NULL;
+        }
+        c->wide |= (unsigned)*e + 32768u > 65535u;
+        idx++;
+        if (++j == m->cols) {
+            j = 0;
+            i++;
+        }
+    }
+    return NULL;
+}
+
+static void report(const char *path, const char *text, const char *at, const char *message)
+{
+    int line = 1, col = 1;
+    for (const char *p = text; p < at; p++) {
+        if (*p == '\n') {
+            line++;
+            col = 1;
+        } else {
+            col++;
+        }
+    }
+    fprintf(stderr, "%s:%d:%d: %s\n", path, line, col, message);
+}
+
+// Run fn on every chunk, chunk 0 on the calling thread. A chunk whose thread
+// cannot be created is processed inline instead.
+static void run_chunks(void *(*fn)(void *), struct chunk *chunks, long threads)
+{
+    pthread_t tids[MAX_THREADS];
+    int started[MAX_THREADS];
+    for (long t = 1; t < threads; t++)
+        started[t] = pthread_create(&tids[t], NULL, fn, &chunks[t]) == 0;
+    fn(&chunks[0]);
+    for (long t = 1; t < threads; t++) {
+        if (started[t])
+            pthread_join(tids[t], NULL);
+        else
+            fn(&chunks[t]);
+    }
+}
+
+// Load a text matrix ("rows cols" then the elements in row order) into m.
+// Returns 0, or -1 after printing path:line:column: reason.
+static int load_text(struct matrix *m, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        fprintf(stderr, "%s: empty file\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    const char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    madvise((void *)text, size, MADV_SEQUENTIAL);
+    const char *end = text + size, *p = text;
+    int ret = -1;
+
+    // header
+    int dims[2];
+    const char *message;
+    for (int h = 0; h < 2; h++) {
+        while (p < end && is_space(*p))
+            p++;
+        if (p == end) {
+            report(path, text, p, "missing \"rows cols\" header");
+            goto out;
+        }
+        const char *at = p;
+        if (parse_int(&p, end, &dims[h], &message) != 0) {
+            report(path, text, p, message);
+            goto out;
+        }
+        if (dims[h] != (h == 0 ? m->rows : m->cols)) {
+            char buf[96];
+            snprintf(buf, sizeof(buf), "header declares %d %s, expected %d",
+                     dims[h], h == 0 ? "rows" : "columns", h == 0 ? m->rows : m->cols);
+            report(path, text, at, buf);
+            goto out;
+        }
+    }
+
+    // split the body at whitespace
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t body = end - p;
+    if (threads > (long)(body / LOADER_MIN_CHUNK))
+        threads = body / LOADER_MIN_CHUNK;
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads < 1)
+        threads = 1;
+    struct chunk chunks[MAX_THREADS];
+    const char *begin = p;
+    for (long t = 0; t < threads; t++) {
+        const char *stop = t == threads - 1 ? end : p + body * (t + 1) / threads;
+        if (stop < begin)
+            stop = begin;
+        while (stop < end && !is_space(*stop))
+            stop++;
+        chunks[t] = (struct chunk){ .begin = begin, .end = stop, .m = m };
+        begin = stop;
+    }
+
+    run_chunks(count_numbers, chunks, threads);
+
+    long first = 0, total = (long)m->rows * m->cols;
+    for (long t = 0; t < threads; t++) {
+        chunks[t].first = first < total ? first : total;
+        first += chunks[t].count;
+    }
+
+    run_chunks(parse_numbers, chunks, threads);
+
+    // the earliest error in the file wins
+    m->narrow = 1;
+    for (long t = 0; t < threads; t++) {
+        m->narrow &= !chunks[t].wide;
+        if (chunks[t].error) {
+            report(path, text, chunks[t].error, chunks[t].message);
+            goto out;
+        }
+    }
+    if (first < total) {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "expected %ld numbers, found %ld", total, first);
+        report(path, text, end, buf);
+        goto out;
+    }
+    ret = 0;
+out:
+    munmap((void *)text, size);
+    return ret;
+}
+
+// name.bin for name.txt when it exists and is at least as new, so operands
+// converted with matconv are picked up without changing the programs
+static int binary_twin(const char *path, char *bin, size_t size)
+{
+    size_t len = strlen(path);
+    struct stat txt_st, bin_st;
+    if (len < 4 || strcmp(path + len - 4, ".txt") != 0 || len >= size)
+        return 0;
+    memcpy(bin, path, len - 4);
+    strcpy(bin + len - 4, ".bin");
+    if (stat(bin, &bin_st) == -1)
+        return 0;
+    if (stat(path, &txt_st) == -1)
+        return 1;
+    return bin_st.st_mtim.tv_sec > txt_st.st_mtim.tv_sec ||
+           (bin_st.st_mtim.tv_sec == txt_st.st_mtim.tv_sec && bin_st.st_mtim.tv_nsec >= txt_st.st_mtim.tv_nsec);
+}
+
+// Load m, which must already be allocated with the dimensions the file is
+// expected to have, from a text or binary matrix file (told apart by the
+// binary magic). Returns 0, or -1 after printing what is wrong.
+int matrix_load_file(struct matrix *m, const char *path)
+{
+    char head[8];
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+    ssize_t n = read(fd, head, sizeof(head));
+    close(fd);
+    if (!matfile_is_binary(head, n > 0 ? n : 0))
+        return load_text(m, path);
+    if (matfile_map(m, path) != 0)
+        return -1;
+    m->narrow = matrix_fits_int16(m);
+    return 0;
+}
+
+// matrix_load_file() on path, or on its binary twin when there is a current one
+int matrix_load(struct matrix *m, const char *path)
+{
+    char bin[PATH_MAX];
+    return matrix_load_file(m, binary_twin(path, bin, sizeof(bin)) ? bin : path);
+}
+
+// Dimensions declared by a text or binary matrix file. Returns 0, or -1 with a message.
+int matrix_dims(const char *path, int *rows, int *cols)
+{
+    if (matfile_dims(path, rows, cols) == 0)
+        return 0;
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    int ok = fscanf(fp, "%d %d", rows, cols) == 2 && *rows > 0 && *cols > 0;
+    fclose(fp);
+    if (!ok)
+        fprintf(stderr, "%s: missing \"rows cols\" header\n", path);
+    return ok ? 0 : -1;
+}
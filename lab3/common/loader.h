@@ -0,0 +1,13 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "matrix.h"
+
+// Files up to this size are parsed by one thread, the cost of starting more isn't worth it
+#define LOADER_MIN_CHUNK (64 * 1024)
+
+int matrix_load(struct matrix *m, const char *path);
+int matrix_load_file(struct matrix *m, const char *path);
+int matrix_dims(const char *path, int *rows, int *cols);
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef LOCKS_H
+#define LOCKS_H
+
+#include <stdlib.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+// Spin locks that stay cheap under contention. Each waiter spins reading a
+// line it does not write, so the lock line only moves on a hand-off:
+//   ttas   - test-and-test-and-set with exponential backoff; unfair
+//   ticket - FIFO; every waiter reads the same owner field
+//   mcs    - FIFO queue; each waiter spins on a flag in its own node
+//   clh    - FIFO queue; each waiter spins on its predecessor's node
+// All are header-only so the fast paths inline. mcs and clh take a
+// per-thread node; the drop-in LOCK_IMPL API below hides it in a
+// thread-local.
+
+#define LOCK_CACHE_LINE 64
+#define LOCK_BACKOFF_MIN 4      // pause instructions after the first failed exchange
+#define LOCK_BACKOFF_MAX 1024
+#define LOCK_SPIN_LIMIT 128     // pauses before a waiter gives up its CPU
+
+static inline void lock_pause(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+// One step of a wait loop. With more threads than CPUs the thread being
+// waited for may not be running, and a FIFO lock can only be handed to the
+// next in line, so spinning on is wasted: yield now and then.
+static inline void lock_wait(unsigned *spins)
+{
+    if (++*spins % LOCK_SPIN_LIMIT == 0)
+        sched_yield();
+    else
+        lock_pause();
+}
+
+// ============================ ttas ============================
+
+struct ttas_lock {
+    atomic_int held;
+};
+
+static inline void ttas_init(struct ttas_lock *l)
+{
+    atomic_init(&l->held, 0);
+}
+
+static inline void ttas_lock(struct ttas_lock *l)
+{
+    unsigned backoff = LOCK_BACKOFF_MIN, spins = 0;
+    for (;;) {
+        // read until it looks free, so waiters share the line instead of bouncing it
+        while (atomic_load_explicit(&l->held, memory_order_relaxed))
+            lock_wait(&spins);
+        if (!atomic_exchange_explicit(&l->held, 1, memory_order_acquire))
+            return;
+        // lost the race: back off so the waiters do not all retry at once
+        for (unsigned i = 0; i < backoff; i++)
+            lock_pause();
+        if (backoff < LOCK_BACKOFF_MAX)
+            backoff *= 2;
+    }
+}
+
+static inline void ttas_unlock(struct ttas_lock *l)
+{
+    atomic_store_explicit(&l->held, 0, memory_order_release);
+}
+
+// ============================ ticket ============================
+
+struct ticket_lock {
+    atomic_uint next;
+    atomic_uint owner;
+};
+
+static inline void ticket_init(struct ticket_lock *l)
+{
+    atomic_init(&l->next, 0);
+    atomic_init(&l->owner, 0);
+}
+
+static inline void ticket_lock(struct ticket_lock *l)
+{
+    unsigned me = atomic_fetch_add_explicit(&l->next, 1, memory_order_relaxed);
+    unsigned owner, spins = 0;
+    // wait in proportion to the queue ahead, so the owner line is polled less the further back we are
+    while ((owner = atomic_load_explicit(&l->owner, memory_order_acquire)) != me) {
+        for (unsigned i = (me - owner) * LOCK_BACKOFF_MIN; i > 0; i--)
+            lock_wait(&spins);
+    }
+}
+
+static inline void ticket_unlock(struct ticket_lock *l)
+{
+    // only the holder writes owner
+    unsigned owner = atomic_load_explicit(&l->owner, memory_order_relaxed);
+    atomic_store_explicit(&l->owner, owner + 1, memory_order_release);
+}
+
+// ============================ mcs ============================
+
+struct mcs_node {
+    _Alignas(LOCK_CACHE_LINE) struct mcs_node *_Atomic next;
+    atomic_int waiting;
+};
+
+struct mcs_lock {
+    struct mcs_node *_Atomic tail;
+};
+
+static inline void mcs_init(struct mcs_lock *l)
+{
+    atomic_init(&l->tail, NULL);
+}
+
+// me must stay valid, and not be used for another lock, until mcs_unlock()
+static inline void mcs_lock(struct mcs_lock *l, struct mcs_node *me)
+{
+    atomic_store_explicit(&me->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&me->waiting, 1, memory_order_relaxed);
+    struct mcs_node *prev = atomic_exchange_explicit(&l->tail, me, memory_order_acq_rel);
+    if (prev == NULL)
+        return;
+    atomic_store_explicit(&prev->next, me, memory_order_release);
+    unsigned spins = 0;
+    while (atomic_load_explicit(&me->waiting, memory_order_acquire))
+        lock_wait(&spins);
+}
+
+static inline void mcs_unlock(struct mcs_lock *l, struct mcs_node *me)
+{
+    struct mcs_node *next = atomic_load_explicit(&me->next, memory_order_acquire);
+    if (next == NULL) {
+        struct mcs_node *expected = me;
+        if (atomic_compare_exchange_strong_explicit(&l->tail, &expected, NULL,
+                                                    memory_order_release, memory_order_relaxed))
+            return;
+        // a successor swapped itself in but has not linked to us yet
+        unsigned spins = 0;
+        while ((next = atomic_load_explicit(&me->next, memory_order_acquire)) == NULL)
+            lock_wait(&spins);
+    }
+    atomic_store_explicit(&next->waiting, 0, memory_order_release);
+}
+
+// ============================ clh ============================
+
+struct clh_node {
+    _Alignas(LOCK_CACHE_LINE) atomic_int waiting;
+};
+
+struct clh_lock {
+    struct clh_node *_Atomic tail;
+};
+
+// A thread's CLH state. Nodes move between threads: after a release the
+// thread keeps its predecessor's node for next time. They can therefore
+// never be freed safely, and a handle's node is allocated on first use.
+struct clh_handle {
+    struct clh_node *node, *pred;
+};
+
+static inline struct clh_node *clh_new_node(void)
+{
+    struct clh_node *n = aligned_alloc(LOCK_CACHE_LINE, sizeof(struct clh_node));
+    if (n == NULL)
+        abort();
+    atomic_init(&n->waiting, 0);
+    return n;
+}
+
+static inline void clh_init(struct clh_lock *l)
+{
+    atomic_init(&l->tail, clh_new_node());
+}
+
+static inline void clh_lock(struct clh_lock *l, struct clh_handle *h)
+{
+    if (h->node == NULL)
+        h->node = clh_new_node();
+    atomic_store_explicit(&h->node->waiting, 1, memory_order_relaxed);
+    h->pred = atomic_exchange_explicit(&l->tail, h->node, memory_order_acq_rel);
+    unsigned spins = 0;
+    while (atomic_load_explicit(&h->pred->waiting, memory_order_acquire))
+        lock_wait(&spins);
+}
+
+static inline void clh_unlock(struct clh_lock *l, struct clh_handle *h)
+{
+    (void)l;
+    struct clh_node *mine = h->node;
+    h->node = h->pred;
+    atomic_store_explicit(&mine->waiting, 0, memory_order_release);
+}
+
+// ============================ drop-in API ============================
+
+// Build with -DLOCK_IMPL=LOCK_IMPL_<TTAS|TICKET|MCS|CLH> to get lock_t,
+// lock_init(), lock_acquire() and lock_release() for that lock. With mcs
+// and clh a thread can hold only one lock_t at a time, because its queue
+// node is a single thread-local; use the explicit-node calls to nest them.
+#define LOCK_IMPL_TTAS 1
+#define LOCK_IMPL_TICKET 2
+#define LOCK_IMPL_MCS 3
+#define LOCK_IMPL_CLH 4
+
+#if defined(LOCK_IMPL) && LOCK_IMPL == LOCK_IMPL_TTAS
+typedef struct ttas_lock lock_t;
+#define LOCK_NAME "ttas"
+static inline void lock_init(lock_t *l) { ttas_init(l); }
+static inline void lock_acquire(lock_t *l) { ttas_lock(l); }
+static inline void lock_release(lock_t *l) { ttas_unlock(l); }
+#elif defined(LOCK_IMPL) && LOCK_IMPL == LOCK_IMPL_TICKET
+typedef struct ticket_lock lock_t;
+#define LOCK_NAME "ticket"
+static inline void lock_init(lock_t *l) { ticket_init(l); }
+static inline void lock_acquire(lock_t *l) { ticket_lock(l); }
+static inline void lock_release(lock_t *l) { ticket_unlock(l); }
+#elif defined(LOCK_IMPL) && LOCK_IMPL == LOCK_IMPL_MCS
+typedef struct mcs_lock lock_t;
+#define LOCK_NAME "mcs"
+static _Thread_local struct mcs_node lock_self;
+static inline void lock_init(lock_t *l) { mcs_init(l); }
+static inline void lock_acquire(lock_t *l) { mcs_lock(l, &lock_self); }
+static inline void lock_release(lock_t *l) { mcs_unlock(l, &lock_self); }
+#elif defined(LOCK_IMPL) && LOCK_IMPL == LOCK_IMPL_CLH
+typedef struct clh_lock lock_t;
+#define LOCK_NAME "clh"
+static _Thread_local struct clh_handle lock_self;
+static inline void lock_init(lock_t *l) { clh_init(l); }
+static inline void lock_acquire(lock_t *l) { clh_lock(l, &lock_self); }
+static inline void lock_release(lock_t *l) { clh_unlock(l, &lock_self); }
+#elif defined(LOCK_IMPL)
+#error "LOCK_IMPL must be one of LOCK_IMPL_TTAS, LOCK_IMPL_TICKET, LOCK_IMPL_MCS, LOCK_IMPL_CLH"
+#endif
+
+#endif
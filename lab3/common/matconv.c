@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "matrix.h"
+#include "loader.h"
+#include "matfile.h"
+
+// matconv: convert a matrix between the text format (m1.txt) and the binary
+// one (m1.bin). The direction follows the input: text becomes binary and
+// binary becomes text. -l picks the binary layout; the matmul programs map
+// the right operand in place when it is stored column-major.
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-l row|col] input output\n", prog);
+    exit(2);
+}
+
+static int save_text(const struct matrix *m, const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(fp, "%d %d\n", m->rows, m->cols);
+    for (int i = 0; i < m->rows; i++) {
+        for (int j = 0; j < m->cols; j++)
+            fprintf(fp, j ? " %d" : "%d", MAT_AT(m, i, j));
+        fputc('\n', fp);
+    }
+    if (ferror(fp) | fclose(fp)) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    enum matrix_layout layout = MATRIX_ROW_MAJOR;
+    int opt, rows, cols;
+    while ((opt = getopt(argc, argv, "l:")) != -1) {
+        if (opt == 'l' && strcmp(optarg, "row") == 0)
+            layout = MATRIX_ROW_MAJOR;
+        else if (opt == 'l' && strcmp(optarg, "col") == 0)
+            layout = MATRIX_COL_MAJOR;
+        else
+            usage(argv[0]);
+    }
+    if (argc - optind != 2)
+        usage(argv[0]);
+    const char *in = argv[optind], *out = argv[optind + 1];
+
+    int binary = matfile_dims(in, &rows, &cols) == 0;
+    if (!binary && matrix_dims(in, &rows, &cols) != 0)
+        return 1;
+    struct matrix m;
+    if (matrix_init(&m, rows, cols, layout) != 0) {
+        perror("matconv");
+        return 1;
+    }
+    // the input itself, not a binary twin matrix_load() would prefer
+    if (matrix_load_file(&m, in) != 0)
+        return 1;
+    int ret = binary ? save_text(&m, out) : matfile_save(&m, out);
+    matrix_free(&m);
+    return ret ? 1 : 0;
+}
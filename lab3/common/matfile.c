@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "matfile.h"
+
+_Static_assert(sizeof(struct matfile_header) == MATFILE_DATA_OFFSET, "header must fill the data offset");
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the binary matrix format is read and written in place, which needs a little-endian host"
+#endif
+
+int matfile_is_binary(const void *head, size_t len)
+{
+    return len >= sizeof(MATFILE_MAGIC) - 1 && memcmp(head, MATFILE_MAGIC, sizeof(MATFILE_MAGIC) - 1) == 0;
+}
+
+static int check_header(const struct matfile_header *h, size_t size, const char *path)
+{
+    const char *problem = NULL;
+    if (h->version != MATFILE_VERSION)
+        problem = "unsupported version";
+    else if (h->elem_type != MATFILE_INT32)
+        problem = "unsupported element type";
+    else if (h->layout != MATRIX_ROW_MAJOR && h->layout != MATRIX_COL_MAJOR)
+        problem = "unknown layout";
+    else if (h->ld < (h->layout == MATRIX_ROW_MAJOR ? h->cols : h->rows))
+        problem = "leading dimension shorter than a row or column";
+    else if (h->data_offset < sizeof(*h) || h->data_offset % MATRIX_ALIGN)
+        problem = "misaligned data";
+    else if (h->data_offset > size)
+        problem = "data offset past the end of the file";
+    else if ((size - h->data_offset) / sizeof(int) <
+             (uint64_t)h->ld * (h->layout == MATRIX_ROW_MAJOR ? h->rows : h->cols))
+        problem = "file is truncated";
+    if (problem)
+        fprintf(stderr, "%s: %s\n", path, problem);
+    return problem ? -1 : 0;
+}
+
+// Read the dimensions from a binary file's header. Returns 0, or -1 if it isn't one.
+int matfile_dims(const char *path, int *rows, int *cols)
+{
+    struct matfile_header h;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return -1;
+    ssize_t n = read(fd, &h, sizeof(h));
+    close(fd);
+    if (n != sizeof(h) || !matfile_is_binary(&h, n))
+        return -1;
+    *rows = h.rows;
+    *cols = h.cols;
+    return 0;
+}
+
+// Load a binary file into m, which holds the expected dimensions and layout.
+// When the file has m's layout and an aligned leading dimension the mapping
+// becomes m's storage, read-only, so it is shared with the page cache rather
+// than copied; otherwise the elements are copied into m's own buffer.
+// Returns 0, or -1 with a message.
+int matfile_map(struct matrix *m, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        perror(path);
+        if (fd != -1)
+            close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    if (size < sizeof(struct matfile_header)) {
+        fprintf(stderr, "%s: not a binary matrix file\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    const struct matfile_header *h = map;
+    if (!matfile_is_binary(h, size) || check_header(h, size, path) != 0)
+        goto fail;
+    if ((int)h->rows != m->rows || (int)h->cols != m->cols) {
+        fprintf(stderr, "%s: matrix is %ux%u, expected %dx%d\n", path, h->rows, h->cols, m->rows, m->cols);
+        goto fail;
+    }
+
+    struct matrix file = {
+        .rows = h->rows, .cols = h->cols, .layout = h->layout,
+        .rs = h->layout == MATRIX_ROW_MAJOR ? (ptrdiff_t)h->ld : 1,
+        .cs = h->layout == MATRIX_ROW_MAJOR ? 1 : (ptrdiff_t)h->ld,
+        .data = (int *)((char *)map + h->data_offset),
+    };
+    if (file.layout == m->layout && h->ld % MATRIX_PAD == 0) {
+        matrix_free(m);
+        *m = file;
+        m->owner = MATRIX_MAPPED;
+        m->map = map;
+        m->map_size = size;
+        return 0;
+    }
+    for (int i = 0; i < m->rows; i++)
+        for (int j = 0; j < m->cols; j++)
+            MAT_AT(m, i, j) = MAT_AT(&file, i, j);
+    munmap(map, size);
+    return 0;
+fail:
+    munmap(map, size);
+    return -1;
+}
+
+// Write m in the binary format, keeping its layout. Returns 0, or -1 with a message.
+int matfile_save(const struct matrix *m, const char *path)
+{
+    // always the padded shape matrix_init() would give, whatever strides m (maybe a view) has
+    ptrdiff_t ld = m->layout == MATRIX_ROW_MAJOR ? m->cols : m->rows;
+    ld = (ld + MATRIX_PAD - 1) / MATRIX_PAD * MATRIX_PAD;
+    struct matfile_header h = {
+        .magic = MATFILE_MAGIC,
+        .version = MATFILE_VERSION,
+        .elem_type = MATFILE_INT32,
+        .rows = m->rows,
+        .cols = m->cols,
+        .layout = m->layout,
+        .ld = ld,
+        .data_offset = MATFILE_DATA_OFFSET,
+    };
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    int outer = m->layout == MATRIX_ROW_MAJOR ? m->rows : m->cols;
+    int inner = m->layout == MATRIX_ROW_MAJOR ? m->cols : m->rows;
+    int *line = calloc(ld, sizeof(int));
+    fwrite(&h, sizeof(h), 1, fp);
+    for (int o = 0; o < outer; o++) {
+        for (int k = 0; k < inner; k++)
+            line[k] = m->layout == MATRIX_ROW_MAJOR ? MAT_AT(m, o, k) : MAT_AT(m, k, o);
+        fwrite(line, sizeof(int), ld, fp);
+    }
+    free(line);
+    if (ferror(fp) | fclose(fp)) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef MATFILE_H
+#define MATFILE_H
+
+#include <stdint.h>
+#include "matrix.h"
+
+// Binary matrix file: a 64-byte little-endian header followed, at
+// data_offset, by the elements exactly as struct matrix stores them
+// (layout and padded leading dimension included), so a file whose layout
+// matches the one asked for is mmap'd and used in place with no copy.
+
+#define MATFILE_MAGIC "LAB3MAT\n"
+#define MATFILE_VERSION 1
+#define MATFILE_INT32 1             // element type: little-endian int32
+#define MATFILE_DATA_OFFSET 64      // keeps the data MATRIX_ALIGN-aligned in the mapping
+
+struct matfile_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t elem_type;
+    uint32_t rows, cols;
+    uint32_t layout;                // enum matrix_layout
+    uint32_t ld;                    // elements between rows (row-major) or columns (column-major)
+    uint64_t data_offset;
+    uint8_t reserved[24];
+};
+
+int matfile_is_binary(const void *head, size_t len);
+int matfile_dims(const char *path, int *rows, int *cols);
+int matfile_map(struct matrix *m, const char *path);
+int matfile_save(const struct matrix *m, const char *path);
+
+#endif
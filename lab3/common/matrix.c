@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "matrix.h"
+
+static ptrdiff_t round_up(ptrdiff_t n, ptrdiff_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+// Allocate a zeroed rows x cols matrix. The leading dimension is padded so
+// that every row (row-major) or column (column-major) starts on a
+// MATRIX_ALIGN boundary. Returns 0, or -1 if the allocation failed.
+int matrix_init(struct matrix *m, int rows, int cols, enum matrix_layout layout)
+{
+    ptrdiff_t ld = round_up(layout == MATRIX_ROW_MAJOR ? cols : rows, MATRIX_PAD);
+    size_t bytes = round_up(ld * (layout == MATRIX_ROW_MAJOR ? rows : cols) * sizeof(int), MATRIX_ALIGN);
+
+    m->rows = rows;
+    m->cols = cols;
+    m->layout = layout;
+    m->rs = layout == MATRIX_ROW_MAJOR ? ld : 1;
+    m->cs = layout == MATRIX_ROW_MAJOR ? 1 : ld;
+    m->owner = MATRIX_HEAP;
+    m->map = NULL;
+    m->map_size = 0;
+    m->narrow = 0;
+    m->data = aligned_alloc(MATRIX_ALIGN, bytes ? bytes : MATRIX_ALIGN);
+    if (m->data == NULL)
+        return -1;
+    memset(m->data, 0, bytes);
+    return 0;
+}
+
+void matrix_free(struct matrix *m)
+{
+    if (m->owner == MATRIX_HEAP)
+        free(m->data);
+    else if (m->owner == MATRIX_MAPPED)
+        munmap(m->map, m->map_size);
+    m->data = NULL;
+    m->owner = 0;
+}
+
+// rows x cols window of m starting at (row, col), sharing m's buffer
+struct matrix matrix_view(const struct matrix *m, int row, int col, int rows, int cols)
+{
+    struct matrix v = *m;
+    v.data = &MAT_AT(m, row, col);
+    v.rows = rows;
+    v.cols = cols;
+    v.owner = 0;
+    return v;
+}
+
+// m^T without copying: a row-major matrix read as column-major and vice versa
+struct matrix matrix_transpose(const struct matrix *m)
+{
+    struct matrix t = *m;
+    t.rows = m->cols;
+    t.cols = m->rows;
+    t.rs = m->cs;
+    t.cs = m->rs;
+    t.layout = m->layout == MATRIX_ROW_MAJOR ? MATRIX_COL_MAJOR : MATRIX_ROW_MAJOR;
+    t.owner = 0;
+    return t;
+}
+
+// Whether every element lies in [INT16_MIN, INT16_MAX], so products can take the int16 kernels
+int matrix_fits_int16(const struct matrix *m)
+{
+    for (int i = 0; i < m->rows; i++)
+        for (int j = 0; j < m->cols; j++)
+            if ((unsigned)MAT_AT(m, i, j) + 32768u > 65535u)
+                return 0;
+    return 1;
+}
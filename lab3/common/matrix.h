@@ -0,0 +1,41 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stddef.h>
+
+// Shared matrix storage for the lab3 matmul programs.
+// A matrix is one aligned, zeroed buffer; element (i, j) lives at
+// data[i*rs + j*cs], so row-major (cs == 1), column-major (rs == 1) and
+// sub-matrix or transposed views all go through the same accessor.
+
+#define MATRIX_ALIGN 64                         // bytes, one cache line / one AVX-512 vector
+#define MATRIX_PAD (MATRIX_ALIGN / sizeof(int)) // leading dimension rounded up to this
+
+enum matrix_layout {
+    MATRIX_ROW_MAJOR,   // rows are contiguous: the usual left operand and result
+    MATRIX_COL_MAJOR,   // columns are contiguous: the right operand of a product
+};
+
+struct matrix {
+    int rows, cols;
+    ptrdiff_t rs, cs;           // distance in elements between rows / columns
+    enum matrix_layout layout;
+    int *data;
+    int owner;                  // MATRIX_HEAP, MATRIX_MAPPED, or 0 for a view
+    void *map;                  // the whole mapping for MATRIX_MAPPED
+    size_t map_size;
+    int narrow;                 // every element fits in int16; set by the loaders, 0 if unknown
+};
+
+#define MATRIX_HEAP 1           // data came from matrix_init()
+#define MATRIX_MAPPED 2         // data points into a read-only mmap of a binary file
+
+#define MAT_AT(m, i, j) ((m)->data[(ptrdiff_t)(i) * (m)->rs + (ptrdiff_t)(j) * (m)->cs])
+
+int matrix_init(struct matrix *m, int rows, int cols, enum matrix_layout layout);
+void matrix_free(struct matrix *m);
+struct matrix matrix_view(const struct matrix *m, int row, int col, int rows, int cols);
+struct matrix matrix_transpose(const struct matrix *m);
+int matrix_fits_int16(const struct matrix *m);
+
+#endif
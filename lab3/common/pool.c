@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "pool.h"
+
+// One Chase-Lev deque per worker (Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models", PPoPP 2013). The owner pushes and
+// pops at the bottom without atomic read-modify-writes; thieves and the
+// owner's pop of the last task race on top with a CAS. Top and bottom sit
+// on their own cache lines so thieves polling one deque do not slow its
+// owner, and deques do not share lines with each other.
+
+#define CACHE_LINE 64
+#define EMPTY -1
+#define ABORT -2
+// failed steal rounds before a worker yields its CPU
+#define SPIN_ROUNDS 64
+
+struct deque {
+    _Alignas(CACHE_LINE) atomic_long top;
+    _Alignas(CACHE_LINE) atomic_long bottom;
+    atomic_int *slots;
+    long mask;
+};
+
+struct worker {
+    struct deque q;
+    int id;
+    unsigned seed;
+    struct pool_stats stats;
+    pthread_t thread;
+    struct shared *s;
+};
+
+struct shared {
+    struct worker *workers;
+    int count;
+    _Alignas(CACHE_LINE) atomic_long remaining;
+    pool_task_fn run;
+    pool_worker_fn done;
+    void *arg;
+};
+
+// The deques never grow: every task is pushed up front, so capacity is the most one worker is dealt
+static void push(struct deque *q, int task)
+{
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    atomic_store_explicit(&q->slots[b & q->mask], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+}
+
+static int pop(struct deque *q)
+{
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return EMPTY;
+    }
+    int task = atomic_load_explicit(&q->slots[b & q->mask], memory_order_relaxed);
+    if (t == b) {
+        // the last task: whoever moves top first gets it
+        if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed))
+            task = EMPTY;
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+static int steal(struct deque *q)
+{
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b)
+        return EMPTY;
+    int task = atomic_load_explicit(&q->slots[t & q->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed))
+        return ABORT;
+    return task;
+}
+
+static int steal_any(struct worker *w)
+{
+    struct shared *s = w->s;
+    if (s->count == 1)
+        return EMPTY;
+    // start at a random victim so thieves spread out instead of all hitting worker 0
+    w->seed = w->seed * 1103515245u + 12345u;
+    int start = (w->seed >> 16) % s->count;
+    for (int n = 0; n < s->count; n++) {
+        struct worker *v = &s->workers[(start + n) % s->count];
+        if (v == w)
+            continue;
+        int task;
+        while ((task = steal(&v->q)) == ABORT)
+            ;
+        if (task != EMPTY)
+            return task;
+    }
+    return EMPTY;
+}
+
+static void *work(void *arg)
+{
+    struct worker *w = arg;
+    struct shared *s = w->s;
+    int idle = 0;
+    while (atomic_load_explicit(&s->remaining, memory_order_acquire) > 0) {
+        int task = pop(&w->q);
+        if (task == EMPTY) {
+            task = steal_any(w);
+            if (task == EMPTY) {
+                if (++idle >= SPIN_ROUNDS) {
+                    sched_yield();
+                    idle = 0;
+                }
+                continue;
+            }
+            w->stats.steals++;
+        }
+        idle = 0;
+        s->run(task, w->id, s->arg);
+        w->stats.tasks++;
+        atomic_fetch_sub_explicit(&s->remaining, 1, memory_order_acq_rel);
+    }
+    if (s->done)
+        s->done(w->id, s->arg);
+    return NULL;
+}
+
+// Online CPUs, at least 1 and at most POOL_MAX_WORKERS
+int pool_default_workers(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1)
+        n = 1;
+    return n > POOL_MAX_WORKERS ? POOL_MAX_WORKERS : (int)n;
+}
+
+// Run tasks 0 .. tasks-1 on workers threads and call done on each worker at
+// the end. stats, if not NULL, receives one entry per worker.
+// Returns 0, or -1 if the workers could not be set up.
+int pool_run(int workers, int tasks, pool_task_fn run, pool_worker_fn done, void *arg,
+             struct pool_stats *stats)
+{
+    if (workers < 1 || workers > POOL_MAX_WORKERS || tasks < 0)
+        return -1;
+    struct shared s = { .count = workers, .run = run, .done = done, .arg = arg };
+    atomic_init(&s.remaining, tasks);
+    s.workers = aligned_alloc(CACHE_LINE, workers * sizeof(struct worker));
+    if (s.workers == NULL)
+        return -1;
+
+    // worker i is dealt the i-th contiguous block, so neighbouring tiles stay on one worker until stolen
+    int per = (tasks + workers - 1) / workers, ret = 0;
+    long cap = 1;
+    while (cap < per)
+        cap <<= 1;
+    for (int i = 0; i < workers; i++) {
+        struct worker *w = &s.workers[i];
+        atomic_init(&w->q.top, 0);
+        atomic_init(&w->q.bottom, 0);
+        w->q.slots = malloc(cap * sizeof(atomic_int));
+        w->q.mask = cap - 1;
+        w->id = i;
+        w->seed = i * 2654435761u + 1;
+        w->stats = (struct pool_stats){ 0 };
+        w->s = &s;
+        if (w->q.slots == NULL)
+            ret = -1;
+        // pushed last-first, so the owner pops its block in order and thieves take from its end
+        for (int t = (i + 1) * per < tasks ? (i + 1) * per : tasks; ret == 0 && --t >= i * per; )
+            push(&w->q, t);
+    }
+
+    int started = 0;
+    while (ret == 0 && started < workers) {
+        if (pthread_create(&s.workers[started].thread, NULL, work, &s.workers[started]) != 0)
+            ret = -1;
+        else
+            started++;
+    }
+    // the workers that did start steal the blocks dealt to any that did not
+    if (started > 0)
+        ret = 0;
+    for (int i = 0; i < started; i++)
+        pthread_join(s.workers[i].thread, NULL);
+    // and done still runs once per worker, here for the ones that never started
+    for (int i = started; ret == 0 && done && i < workers; i++)
+        done(i, arg);
+
+    for (int i = 0; i < workers; i++) {
+        if (stats)
+            stats[i] = s.workers[i].stats;
+        free(s.workers[i].q.slots);
+    }
+    free(s.workers);
+    return ret;
+}
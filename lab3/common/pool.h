@@ -0,0 +1,27 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Work-stealing thread pool for the lab3 programs. pool_run() starts the
+// workers, deals the tasks out to their deques in contiguous blocks, and
+// returns when every task has run. A worker pops its own deque from the
+// bottom and, once that is empty, steals from the top of random victims, so
+// uneven tasks or a descheduled worker are balanced without a shared queue.
+
+#define POOL_MAX_WORKERS 256
+
+// Runs task number task on worker worker (0-based)
+typedef void (*pool_task_fn)(int task, int worker, void *arg);
+// Runs once on each worker after the last task is done, before it exits (on the
+// calling thread, after the others, for a worker whose thread could not be created)
+typedef void (*pool_worker_fn)(int worker, void *arg);
+
+struct pool_stats {
+    long tasks;     // tasks run by this worker
+    long steals;    // of those, taken from another worker
+};
+
+int pool_default_workers(void);
+int pool_run(int workers, int tasks, pool_task_fn run, pool_worker_fn done, void *arg,
+             struct pool_stats *stats);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SKINNY_H
+#define SKINNY_H
+
+#include "matrix.h"
+
+// Row-streaming kernel body for a B with a few columns, shared by gemm()'s
+// skinny path (K known at run time) and the shape-specialised kernels in
+// fixed.c (K a constant, so every trip count is). A is row-major and B
+// column-major. Each row of A is loaded once, a vector at a time, and
+// multiplied into one vector of partial sums per column of B, so all N
+// accumulators stay in registers; the K % lanes tail is peeled and each
+// column's lanes are folded into C at the end of the row. Unsigned, so
+// overflow wraps like the rest of gemm(). Expands inside a function with
+// a, b, c, row_begin and row_end in scope; N must be a constant.
+
+// unaligned and may alias the int data
+typedef unsigned skinny_v8 __attribute__((vector_size(32), aligned(4), may_alias));
+typedef unsigned skinny_v16 __attribute__((vector_size(64), aligned(4), may_alias));
+
+#define SKINNY_ROWS(K, N, VEC)                                                      \
+    do {                                                                            \
+        enum { LANES = sizeof(VEC) / sizeof(unsigned) };                            \
+        const int kdim_ = (K), kv_ = kdim_ / LANES * LANES;                         \
+        for (int i = row_begin; i < row_end; i++) {                                 \
+            const unsigned *ai = (const unsigned *)&MAT_AT(a, i, 0);                \
+            VEC acc[N] = { 0 };                                                     \
+            for (int k = 0; k < kv_; k += LANES) {                                  \
+                VEC av = *(const VEC *)(ai + k);                                    \
+                _Pragma("GCC unroll 16")                                            \
+                for (int j = 0; j < (N); j++)                                       \
+                    acc[j] += av * *(const VEC *)&MAT_AT(b, k, j);                  \
+            }                                                                       \
+            _Pragma("GCC unroll 16")                                                \
+            for (int j = 0; j < (N); j++) {                                         \
+                unsigned sum = 0;                                                   \
+                for (int k = kv_; k < kdim_; k++)                                   \
+                    sum += ai[k] * (unsigned)MAT_AT(b, k, j);                       \
+                for (int l = 0; l < LANES; l++)                                     \
+                    sum += acc[j][l];                                               \
+                MAT_AT(c, i, j) = (int)((unsigned)MAT_AT(c, i, j) + sum);           \
+            }                                                                       \
+        }                                                                           \
+    } while (0)
+
+#endif
@@ -0,0 +1,233 @@
+#include "strassen.h"
+#include "gemm.h"
+
+// rows of C per pool task when the product is too small to split
+#define ROWS_PER_TASK 64
+
+// The pool a top-level call runs on; NULL below it, where work stays on the calling thread
+struct team {
+    int workers;
+    pool_worker_fn done;
+    void *arg;
+    pool_task_fn run;   // the current batch of tasks and their data
+    void *data;
+};
+
+struct product {
+    struct matrix x, y;         // operands, views or temporaries
+    struct matrix p;            // x * y, zeroed before the task
+    int threshold;
+    int status;
+};
+
+static int winograd(const struct matrix *a, const struct matrix *b, struct matrix *c, int threshold,
+                    struct team *team);
+
+// d = x + sign * y, elementwise mod 2^32, setting d->narrow when x and y are
+// narrow and the sums still fit int16 so the fast kernels stay usable.
+// Operands share d's layout (views of A or B, or temporaries made like
+// them), so walk whichever way is contiguous.
+static void combine(struct matrix *d, const struct matrix *x, const struct matrix *y, int sign)
+{
+    struct matrix xt, yt, dt;
+    struct matrix *w = d;
+    if (d->layout == MATRIX_COL_MAJOR) {
+        dt = matrix_transpose(d), xt = matrix_transpose(x), yt = matrix_transpose(y);
+        w = &dt, x = &xt, y = &yt;
+    }
+    unsigned wide = 0;
+    for (int i = 0; i < w->rows; i++) {
+        unsigned *dr = (unsigned *)&MAT_AT(w, i, 0);
+        const unsigned *xr = (const unsigned *)&MAT_AT(x, i, 0), *yr = (const unsigned *)&MAT_AT(y, i, 0);
+        for (int j = 0; j < w->cols; j++) {
+            dr[j] = sign > 0 ? xr[j] + yr[j] : xr[j] - yr[j];
+            wide |= dr[j] + 32768u > 65535u;
+        }
+    }
+    d->narrow = x->narrow && y->narrow && !wide;
+}
+
+static void product_task(int task, int worker, void *arg)
+{
+    (void)worker;
+    struct product *p = &((struct product *)arg)[task];
+    p->status = winograd(&p->x, &p->y, &p->p, p->threshold, NULL);
+}
+
+// pool_run() hands one argument to both hooks; these give each its own
+static void team_task(int task, int worker, void *arg)
+{
+    struct team *team = arg;
+    team->run(task, worker, team->data);
+}
+
+static void team_done(int worker, void *arg)
+{
+    struct team *team = arg;
+    if (team->done)
+        team->done(worker, team->arg);
+}
+
+// Run tasks on the team's pool, or one after another without a team
+static int run_tasks(struct team *team, int tasks, pool_task_fn run, void *data)
+{
+    if (team == NULL) {
+        for (int i = 0; i < tasks; i++)
+            run(i, 0, data);
+        return 0;
+    }
+    team->run = run;
+    team->data = data;
+    return pool_run(team->workers, tasks, team_task, team_done, team, NULL);
+}
+
+struct row_split {
+    const struct matrix *a, *b;
+    struct matrix *c;
+};
+
+static void rows_task(int task, int worker, void *arg)
+{
+    (void)worker;
+    struct row_split *s = arg;
+    int begin = task * ROWS_PER_TASK;
+    int end = begin + ROWS_PER_TASK < s->c->rows ? begin + ROWS_PER_TASK : s->c->rows;
+    gemm_rows(s->a, s->b, s->c, begin, end);
+}
+
+// The classical product, split by rows over the pool when there is one
+static int classical(const struct matrix *a, const struct matrix *b, struct matrix *c, struct team *team)
+{
+    if (team == NULL) {
+        gemm(a, b, c);
+        return 0;
+    }
+    struct row_split s = { a, b, c };
+    return run_tasks(team, (c->rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK, rows_task, &s);
+}
+
+// C += A * B for even dimensions 2mh x 2kh times 2kh x 2nh
+static int winograd_even(const struct matrix *a, const struct matrix *b, struct matrix *c,
+                         int mh, int kh, int nh, int threshold, struct team *team)
+{
+    struct matrix a11 = matrix_view(a, 0, 0, mh, kh), a12 = matrix_view(a, 0, kh, mh, kh);
+    struct matrix a21 = matrix_view(a, mh, 0, mh, kh), a22 = matrix_view(a, mh, kh, mh, kh);
+    struct matrix b11 = matrix_view(b, 0, 0, kh, nh), b12 = matrix_view(b, 0, nh, kh, nh);
+    struct matrix b21 = matrix_view(b, kh, 0, kh, nh), b22 = matrix_view(b, kh, nh, kh, nh);
+    struct matrix s[4], t[4];
+    struct product prod[7];
+    int ret = -1, ns = 0, nt = 0, np = 0, allocated = 0;
+
+    for (; ns < 4; ns++)
+        if (matrix_init(&s[ns], mh, kh, a->layout) != 0)
+            goto out;
+    for (; nt < 4; nt++)
+        if (matrix_init(&t[nt], kh, nh, b->layout) != 0)
+            goto out;
+    for (; np < 7; np++)
+        if (matrix_init(&prod[np].p, mh, nh, MATRIX_ROW_MAJOR) != 0)
+            goto out;
+    allocated = 1;
+
+    combine(&s[0], &a21, &a22, 1);      // S1 = A21 + A22
+    combine(&s[1], &s[0], &a11, -1);    // S2 = S1 - A11
+    combine(&s[2], &a11, &a21, -1);     // S3 = A11 - A21
+    combine(&s[3], &a12, &s[1], -1);    // S4 = A12 - S2
+    combine(&t[0], &b12, &b11, -1);     // T1 = B12 - B11
+    combine(&t[1], &b22, &t[0], -1);    // T2 = B22 - T1
+    combine(&t[2], &b22, &b12, -1);     // T3 = B22 - B12
+    combine(&t[3], &t[1], &b21, -1);    // T4 = T2 - B21
+
+    const struct matrix *operands[7][2] = {
+        { &a11, &b11 }, { &a12, &b21 }, { &s[3], &b22 }, { &a22, &t[3] },
+        { &s[0], &t[0] }, { &s[1], &t[1] }, { &s[2], &t[2] },
+    };
+    for (int i = 0; i < 7; i++) {
+        prod[i].x = *operands[i][0];
+        prod[i].y = *operands[i][1];
+        prod[i].threshold = threshold;
+        prod[i].status = 0;
+    }
+    // the seven products are independent: one pool task each at the top level
+    if (run_tasks(team, 7, product_task, prod) != 0)
+        goto out;
+    for (int i = 0; i < 7; i++)
+        if (prod[i].status != 0)
+            goto out;
+
+    // C (row-major, see strassen()) gets U1, U4 + P3, U3 - P4 and U3 + P5
+    for (int i = 0; i < mh; i++) {
+        const unsigned *p[7];
+        for (int q = 0; q < 7; q++)
+            p[q] = (const unsigned *)&MAT_AT(&prod[q].p, i, 0);
+        unsigned *c1 = (unsigned *)&MAT_AT(c, i, 0), *c2 = (unsigned *)&MAT_AT(c, i + mh, 0);
+        for (int j = 0; j < nh; j++) {
+            unsigned u2 = p[0][j] + p[5][j], u3 = u2 + p[6][j], u4 = u2 + p[4][j];
+            c1[j] += p[0][j] + p[1][j];
+            c1[j + nh] += u4 + p[2][j];
+            c2[j] += u3 - p[3][j];
+            c2[j + nh] += u3 + p[4][j];
+        }
+    }
+    ret = 0;
+out:
+    while (ns > 0)
+        matrix_free(&s[--ns]);
+    while (nt > 0)
+        matrix_free(&t[--nt]);
+    while (np > 0)
+        matrix_free(&prod[--np].p);
+    // no room for the temporaries: multiply classically, still on the team so its hook runs
+    if (!allocated)
+        return classical(a, b, c, team);
+    return ret;
+}
+
+static int winograd(const struct matrix *a, const struct matrix *b, struct matrix *c, int threshold,
+                    struct team *team)
+{
+    int m = c->rows, n = c->cols, k = a->cols;
+    if (m <= threshold || n <= threshold || k <= threshold || m < 2 || n < 2 || k < 2)
+        return classical(a, b, c, team);
+
+    int mh = m / 2, kh = k / 2, nh = n / 2;
+    struct matrix ae = matrix_view(a, 0, 0, 2 * mh, 2 * kh), be = matrix_view(b, 0, 0, 2 * kh, 2 * nh);
+    struct matrix ce = matrix_view(c, 0, 0, 2 * mh, 2 * nh);
+    if (winograd_even(&ae, &be, &ce, mh, kh, nh, threshold, team) != 0)
+        return -1;
+
+    // peel what the even part left out: the last k slice, column and row
+    if (k & 1) {
+        struct matrix ak = matrix_view(a, 0, k - 1, 2 * mh, 1), bk = matrix_view(b, k - 1, 0, 1, 2 * nh);
+        gemm(&ak, &bk, &ce);
+    }
+    if (n & 1) {
+        struct matrix ar = matrix_view(a, 0, 0, 2 * mh, k), bc = matrix_view(b, 0, n - 1, k, 1);
+        struct matrix cc = matrix_view(c, 0, n - 1, 2 * mh, 1);
+        gemm(&ar, &bc, &cc);
+    }
+    if (m & 1) {
+        struct matrix ar = matrix_view(a, m - 1, 0, 1, k), cr = matrix_view(c, m - 1, 0, 1, n);
+        gemm(&ar, b, &cr);
+    }
+    return 0;
+}
+
+// C += A * B, switching to gemm() once a dimension is <= threshold. The
+// top-level products run on a pool of workers threads (done runs on each
+// of them at the end, as with pool_run()); deeper levels stay on the
+// thread that owns the product; without memory for the temporaries the
+// product is done classically. Returns 0, or -1 if the pool failed to start.
+int strassen(const struct matrix *a, const struct matrix *b, struct matrix *c, int threshold,
+             int workers, pool_worker_fn done, void *arg)
+{
+    struct team team = { workers, done, arg, NULL, NULL };
+    if (threshold < 1)
+        threshold = 1;
+    // the recursion writes C a row at a time; a column-major C is C^T = B^T A^T in row-major
+    if (c->layout == MATRIX_COL_MAJOR) {
+        struct matrix at = matrix_transpose(a), bt = matrix_transpose(b), ct = matrix_transpose(c);
+        return winograd(&bt, &at, &ct, threshold, &team);
+    }
+    return winograd(a, b, c, threshold, &team);
+}
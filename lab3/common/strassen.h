@@ -0,0 +1,25 @@
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include "matrix.h"
+#include "pool.h"
+
+// Strassen-Winograd: C += A * B with 7 half-size products and 15 additions
+// per level instead of 8 products, recursing until a dimension is at or
+// below the threshold and the blocked gemm() takes over. Odd dimensions
+// are peeled: the even part recurses and the leftover row, column and k
+// slice are added with gemm(). Arithmetic wraps mod 2^32 like every other
+// lab3 kernel; since the algorithm is exact over any ring, the result is
+// bit-identical to the classical product.
+//
+// Each level trades one product for 15 passes over quarter-size
+// temporaries, so it only pays once gemm() itself is compute bound: on
+// int32 operands it breaks even around 2048, and with the int16 kernels
+// the crossover is further out still.
+
+#define STRASSEN_THRESHOLD 1024
+
+int strassen(const struct matrix *a, const struct matrix *b, struct matrix *c, int threshold,
+             int workers, pool_worker_fn done, void *arg);
+
+#endif
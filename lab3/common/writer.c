@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "writer.h"
+
+// Result writer: row blocks are formatted in parallel into per-thread
+// buffers, then handed to the kernel in order with writev(). The text is
+// the one the programs always printed: "%d " per element, "\n" per row.
+
+#define MAX_THREADS 64
+#define ELEM_MAX 12             // "-2147483648 "
+
+struct block {
+    const struct matrix *m;
+    int row_begin, row_end;
+    char *buf;
+    size_t len;
+};
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Write v in decimal followed by a space at p, returning the end
+static char *format_int(char *p, int v)
+{
+    char tmp[ELEM_MAX];
+    char *t = tmp + sizeof(tmp);
+    unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+    while (u >= 100) {
+        unsigned r = u % 100;
+        u /= 100;
+        t -= 2;
+        memcpy(t, digit_pairs + 2 * r, 2);
+    }
+    if (u >= 10) {
+        t -= 2;
+        memcpy(t, digit_pairs + 2 * u, 2);
+    } else {
+        *--t = '0' + u;
+    }
+    if (v < 0)
+        *--t = '-';
+    size_t n = tmp + sizeof(tmp) - t;
+    memcpy(p, t, n);
+    p[n] = ' ';
+    return p + n + 1;
+}
+
+static void *format_block(void *arg)
+{
+    struct block *b = arg;
+    const struct matrix *m = b->m;
+    char *p = b->buf;
+    for (int i = b->row_begin; i < b->row_end; i++) {
+        for (int j = 0; j < m->cols; j++)
+            p = format_int(p, MAT_AT(m, i, j));
+        *p++ = '\n';
+    }
+    b->len = p - b->buf;
+    return NULL;
+}
+
+// Append the elements of m to fp (after what fp has buffered). Returns 0, or -1 on error.
+int matrix_write(FILE *fp, const struct matrix *m)
+{
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long elems = (long)m->rows * m->cols;
+    if (threads > elems / WRITER_MIN_ELEMS)
+        threads = elems / WRITER_MIN_ELEMS;
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads > m->rows)
+        threads = m->rows;
+    if (threads < 1)
+        threads = 1;
+
+    struct block blocks[MAX_THREADS];
+    pthread_t tids[MAX_THREADS];
+    int started[MAX_THREADS];
+    int ret = 0;
+    for (long t = 0; t < threads; t++) {
+        blocks[t].m = m;
+        blocks[t].row_begin = m->rows * t / threads;
+        blocks[t].row_end = m->rows * (t + 1) / threads;
+        blocks[t].buf = malloc((size_t)(blocks[t].row_end - blocks[t].row_begin) * ((size_t)m->cols * ELEM_MAX + 1) + 1);
+        if (blocks[t].buf == NULL)
+            ret = -1;
+    }
+    if (ret == 0) {
+        for (long t = 1; t < threads; t++)
+            started[t] = pthread_create(&tids[t], NULL, format_block, &blocks[t]) == 0;
+        format_block(&blocks[0]);
+        // a block whose thread could not be created is formatted here instead
+        for (long t = 1; t < threads; t++) {
+            if (started[t])
+                pthread_join(tids[t], NULL);
+            else
+                format_block(&blocks[t]);
+        }
+
+        // whatever the program already printed with stdio goes first
+        if (fflush(fp) != 0)
+            ret = -1;
+        struct iovec iov[MAX_THREADS];
+        for (long t = 0; t < threads; t++) {
+            iov[t].iov_base = blocks[t].buf;
+            iov[t].iov_len = blocks[t].len;
+        }
+        // writev may stop short, so resume from wherever it did
+        struct iovec *v = iov;
+        long left = threads;
+        while (ret == 0 && left > 0) {
+            ssize_t n = writev(fileno(fp), v, left);
+            if (n < 0) {
+                ret = -1;
+                break;
+            }
+            while (left > 0 && (size_t)n >= v->iov_len) {
+                n -= v->iov_len;
+                v++;
+                left--;
+            }
+            if (left > 0) {
+                v->iov_base = (char *)v->iov_base + n;
+                v->iov_len -= n;
+            }
+        }
+    }
+    for (long t = 0; t < threads; t++)
+        free(blocks[t].buf);
+    return ret;
+}
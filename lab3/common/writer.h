@@ -0,0 +1,12 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+#include "matrix.h"
+
+// Fewer elements than this per thread and the output is formatted by one thread
+#define WRITER_MIN_ELEMS (64 * 1024)
+
+int matrix_write(FILE *fp, const struct matrix *m);
+
+#endif